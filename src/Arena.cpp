@@ -0,0 +1,59 @@
+#include "Arena.h"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+Arena::~Arena()
+{
+	for (auto& block : mBlocks)
+	{
+		std::free(block.data);
+	}
+}
+
+void* Arena::Allocate(size_t size, size_t align)
+{
+	// round the bump pointer up to the alignment
+	uintptr_t ptr = reinterpret_cast<uintptr_t>(mPtr);
+	uintptr_t aligned = (ptr + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+	if (mPtr == nullptr || aligned + size > reinterpret_cast<uintptr_t>(mEnd))
+	{
+		NextBlock(size + align);
+		ptr = reinterpret_cast<uintptr_t>(mPtr);
+		aligned = (ptr + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+	}
+
+	mPtr = reinterpret_cast<char*>(aligned + size);
+	return reinterpret_cast<void*>(aligned);
+}
+
+void Arena::Reset()
+{
+	// blocks are kept for reuse, so repeated compilations don't go back to malloc
+	mCurrent = 0;
+	mPtr = mBlocks.empty() ? nullptr : mBlocks[0].data;
+	mEnd = mBlocks.empty() ? nullptr : mBlocks[0].data + mBlocks[0].size;
+}
+
+void Arena::NextBlock(size_t size)
+{
+	// the first time through, start on block 0; after that move past the current one
+	size_t next = mPtr == nullptr ? 0 : mCurrent + 1;
+
+	// reuse a block left over from before the last Reset if it is big enough,
+	// otherwise put a new one in its place
+	if (next >= mBlocks.size() || mBlocks[next].size < size)
+	{
+		size_t blockSize = size > kBlockSize ? size : kBlockSize;
+		Block block = { static_cast<char*>(std::malloc(blockSize)), blockSize };
+		if (block.data == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		mBlocks.insert(mBlocks.begin() + next, block);
+	}
+
+	mCurrent = next;
+	mPtr = mBlocks[next].data;
+	mEnd = mBlocks[next].data + mBlocks[next].size;
+}
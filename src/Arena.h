@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Arena
+// bump-pointer allocator that holds the AST arrays of one compilation.
+// Memory taken from it is never freed piece by piece: Reset() rewinds the
+// arena in O(1) and keeps its blocks around for the next compilation, so
+// containers put in it go through ArenaAllocator (ArenaVector).
+class Arena
+{
+public:
+	// size of a regular block, bigger requests get a block of their own
+	static const size_t kBlockSize = 64 * 1024;
+
+	Arena() = default;
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+	~Arena();
+
+	// raw, aligned storage
+	void* Allocate(size_t size, size_t align);
+
+	// releases everything allocated so far
+	void Reset();
+
+private:
+	struct Block
+	{
+		char* data;
+		size_t size;
+	};
+
+	// moves on to a block with room for size bytes
+	void NextBlock(size_t size);
+
+	std::vector<Block> mBlocks;
+	// block currently being filled
+	size_t mCurrent = 0;
+	char* mPtr = nullptr;
+	char* mEnd = nullptr;
+};
+
+// ArenaAllocator
+// lets standard containers take their storage from an Arena;
+// deallocate is a no-op, the memory goes away with the arena
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(Arena& arena)
+		:mArena(&arena)
+	{ }
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other)
+		:mArena(other.GetArena())
+	{ }
+
+	T* allocate(size_t n) { return static_cast<T*>(mArena->Allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) { }
+
+	Arena* GetArena() const { return mArena; }
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return mArena == other.GetArena(); }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return mArena != other.GetArena(); }
+
+private:
+	Arena* mArena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
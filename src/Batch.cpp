@@ -0,0 +1,213 @@
+#include "Batch.h"
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+#include "Compiler.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	// one input and everything its compilation produced
+	struct BatchJob
+	{
+		std::string inputPath;
+		CompileOptions options;
+		int result = 0;
+		CompileStats stats;
+		// syntax errors/traces, printed in input order once everything is done
+		std::string diag;
+	};
+
+	bool IsDirectory(const std::string& path)
+	{
+		struct stat info;
+		return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFMT) == S_IFDIR;
+	}
+
+	// creates path and whichever of its parents don't exist yet;
+	// false if it isn't a directory afterwards
+	bool MakeDirectory(const std::string& path)
+	{
+		if (IsDirectory(path))
+		{
+			return true;
+		}
+		size_t slash = path.find_last_of("/\\");
+		if (slash != std::string::npos && slash > 0 && path[slash - 1] != ':'
+			&& !MakeDirectory(path.substr(0, slash)))
+		{
+			return false;
+		}
+#ifdef _WIN32
+		_mkdir(path.c_str());
+#else
+		mkdir(path.c_str(), 0755);
+#endif
+		return IsDirectory(path);
+	}
+
+	// *.pcc files directly inside dir, sorted by name
+	void ListSources(const std::string& dir, std::vector<std::string>& paths)
+	{
+		std::vector<std::string> names;
+#ifdef _WIN32
+		_finddata_t data;
+		intptr_t handle = _findfirst((dir + "/*.pcc").c_str(), &data);
+		if (handle != -1)
+		{
+			do
+			{
+				names.emplace_back(data.name);
+			} while (_findnext(handle, &data) == 0);
+			_findclose(handle);
+		}
+#else
+		DIR* handle = opendir(dir.c_str());
+		if (handle != nullptr)
+		{
+			while (dirent* entry = readdir(handle))
+			{
+				std::string name(entry->d_name);
+				if (name.size() > 4 && name.compare(name.size() - 4, 4, ".pcc") == 0)
+				{
+					names.emplace_back(name);
+				}
+			}
+			closedir(handle);
+		}
+#endif
+		std::sort(names.begin(), names.end());
+		for (auto& name : names)
+		{
+			paths.emplace_back(dir + "/" + name);
+		}
+	}
+
+	// file name without directory or extension
+	std::string Stem(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		size_t dot = name.find_last_of('.');
+		return dot == std::string::npos ? name : name.substr(0, dot);
+	}
+}
+
+int RunBatch(int argc, const char* argv[])
+{
+	if (argc < 4)
+	{
+		std::cout << "Usage: --batch <mode> [-j threads] [-o outdir] <file or directory>..." << std::endl;
+		return 1;
+	}
+
+	std::string mode(argv[2]);
+	int numThreads = static_cast<int>(std::thread::hardware_concurrency());
+	std::string outDir = ".";
+	std::vector<std::string> inputs;
+	for (int i = 3; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg == "-j" && i + 1 < argc)
+		{
+			numThreads = std::atoi(argv[++i]);
+		}
+		else if (arg == "-o" && i + 1 < argc)
+		{
+			outDir = argv[++i];
+		}
+		else if (IsDirectory(arg))
+		{
+			ListSources(arg, inputs);
+		}
+		else
+		{
+			inputs.emplace_back(arg);
+		}
+	}
+	if (numThreads < 1)
+	{
+		numThreads = 1;
+	}
+
+	// outputs are named after the input, so two inputs can't share a name
+	std::vector<BatchJob> jobs(inputs.size());
+	std::set<std::string> stems;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		std::string stem = Stem(inputs[i]);
+		if (!stems.insert(stem).second)
+		{
+			std::cout << "Duplicate input name: " << inputs[i] << std::endl;
+			return 1;
+		}
+
+		BatchJob& job = jobs[i];
+		job.inputPath = inputs[i];
+		ParseModeOptions(mode, job.options);
+		std::string base = outDir + "/" + stem;
+		job.options.astPath = base + ".ast.txt";
+		job.options.emitPath = base + ".emit.txt";
+		job.options.regPath = base + ".reg.txt";
+		job.options.regEmitPath = base + ".reg.emit.txt";
+	}
+	if (!MakeDirectory(outDir))
+	{
+		std::cout << "Cannot create output directory " << outDir << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		ThreadPool pool(numThreads);
+		for (auto& job : jobs)
+		{
+			BatchJob* current = &job;
+			pool.Submit([current] {
+				std::ostringstream diag;
+				current->result = CompileFile(current->inputPath, current->options, diag, &current->stats);
+				current->diag = diag.str();
+			});
+		}
+		pool.Wait();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// report in input order, so the output doesn't depend on scheduling
+	int failed = 0;
+	long long lines = 0;
+	for (auto& job : jobs)
+	{
+		std::cout << job.diag;
+		if (job.result != 0)
+		{
+			std::cout << "FAILED: " << job.inputPath << '\n';
+			failed++;
+		}
+		lines += job.stats.lines;
+	}
+
+	double rate = seconds > 0.0 ? 1.0 / seconds : 0.0;
+	std::cout << "Compiled " << jobs.size() << " files (" << lines << " lines, "
+		<< failed << " failed) on " << numThreads << " threads in " << seconds << " s: "
+		<< jobs.size() * rate << " files/s, " << lines * rate << " lines/s" << std::endl;
+
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Batch mode: compiles many .pcc files on a thread pool.
+//   main --batch <mode> [-j threads] [-o outdir] <file or directory>...
+// Directories are searched for *.pcc files. Each input writes
+// <outdir>/<name>.ast.txt, .emit.txt, .reg.txt and .reg.emit.txt, matching
+// the layout of expected/, according to the same mode string as a single
+// compile. argv[1] is "--batch". Returns 0 if every input compiled.
+int RunBatch(int argc, const char* argv[]);
@@ -0,0 +1,379 @@
+#include "CFG.h"
+#include <algorithm>
+#include <utility>
+
+void CFG::Build(const CodeContext& program)
+{
+	mBlocks.clear();
+	mOrder.clear();
+	mLoops.clear();
+	mDomChildren.clear();
+
+	SplitBlocks(program);
+	AddEdges(program);
+	ComputeOrder();
+	ComputeDominators();
+	FindLoops();
+}
+
+int CFG::GetBlockOf(int index) const
+{
+	// last block that starts at or before index
+	auto it = std::upper_bound(mBlocks.begin(), mBlocks.end(), index,
+		[](int i, const BasicBlock& block) { return i < block.first; });
+	return static_cast<int>(it - mBlocks.begin()) - 1;
+}
+
+bool CFG::Dominates(int a, int b) const
+{
+	// a's subtree of the dominator tree covers b's pre-order number
+	return IsReachable(a) && IsReachable(b)
+		&& mDomPre[a] <= mDomPre[b] && mDomPost[b] <= mDomPost[a];
+}
+
+bool CFG::IsLoopHeader(int block) const
+{
+	int loop = mBlocks[block].loop;
+	return loop >= 0 && mLoops[loop].header == block;
+}
+
+// A block starts at the program start, after a jnt/jmp/exit and at every
+// label. A label directly followed by another one gets a block with nothing
+// in it, so that each label stands for exactly one block and the edges out
+// of it (phis name their predecessors by label, and passes can empty blocks).
+void CFG::SplitBlocks(const CodeContext& program)
+{
+	mLabelBlock.assign(program.lastLabelIndex, -1);
+
+	int size = static_cast<int>(program.opsVector.size());
+	bool startBlock = true;
+	for (int i = 0; i < size; i++)
+	{
+		const Ops& ops = program.opsVector[i];
+		if (startBlock || (ops.op == OpCode::Label && mBlocks.back().first != i))
+		{
+			if (!mBlocks.empty())
+			{
+				mBlocks.back().end = i;
+			}
+			mBlocks.emplace_back();
+			mBlocks.back().first = i;
+			startBlock = false;
+		}
+
+		int block = static_cast<int>(mBlocks.size()) - 1;
+		switch (ops.op)
+		{
+		case OpCode::Label:
+			mLabelBlock[ops.params[0].value] = block;
+			break;
+		case OpCode::Jnt:
+		case OpCode::Jmp:
+		case OpCode::Exit:
+			startBlock = true;
+			break;
+		default:
+			break;
+		}
+	}
+	if (!mBlocks.empty())
+	{
+		mBlocks.back().end = size;
+	}
+}
+
+void CFG::AddEdge(int from, int to)
+{
+	std::vector<int>& succs = mBlocks[from].succs;
+	if (std::find(succs.begin(), succs.end(), to) == succs.end())
+	{
+		succs.emplace_back(to);
+		mBlocks[to].preds.emplace_back(from);
+	}
+}
+
+void CFG::AddEdges(const CodeContext& program)
+{
+	// label loaded into each VR by a movi; CodeGen writes every VR once
+	std::vector<int> labelOf(program.lastVRegIndex, -1);
+	for (const Ops& ops : program.opsVector)
+	{
+		if (ops.op == OpCode::Movi && ops.params[0].IsVReg()
+			&& ops.params[1].kind == OperandKind::Label)
+		{
+			labelOf[ops.params[0].value] = ops.params[1].value;
+		}
+	}
+
+	int numBlocks = GetNumBlocks();
+	for (int b = 0; b < numBlocks; b++)
+	{
+		const Ops& last = program.opsVector[mBlocks[b].end - 1];
+		bool fallsThrough = last.op != OpCode::Jmp && last.op != OpCode::Exit;
+		if (fallsThrough && b + 1 < numBlocks)
+		{
+			AddEdge(b, b + 1);
+		}
+		if (last.op != OpCode::Jnt && last.op != OpCode::Jmp)
+		{
+			continue;
+		}
+
+		const Operand& target = last.params[0];
+		if (target.IsVReg() && labelOf[target.value] >= 0)
+		{
+			AddEdge(b, mLabelBlock[labelOf[target.value]]);
+			continue;
+		}
+		// target unknown: it can be any label
+		for (int labelBlock : mLabelBlock)
+		{
+			if (labelBlock >= 0)
+			{
+				AddEdge(b, labelBlock);
+			}
+		}
+	}
+}
+
+// depth-first from the entry with an explicit stack, like the AST walkers
+void CFG::ComputeOrder()
+{
+	if (mBlocks.empty())
+	{
+		return;
+	}
+
+	std::vector<char> visited(mBlocks.size(), 0);
+	// block and the index of its next successor to visit
+	std::vector<std::pair<int, size_t>> stack;
+	stack.emplace_back(0, 0);
+	visited[0] = 1;
+	while (!stack.empty())
+	{
+		int block = stack.back().first;
+		size_t next = stack.back().second;
+		const std::vector<int>& succs = mBlocks[block].succs;
+		if (next < succs.size())
+		{
+			stack.back().second++;
+			int succ = succs[next];
+			if (!visited[succ])
+			{
+				visited[succ] = 1;
+				stack.emplace_back(succ, 0);
+			}
+			continue;
+		}
+		// all successors done, the block goes after them in post-order
+		mOrder.emplace_back(block);
+		stack.pop_back();
+	}
+
+	std::reverse(mOrder.begin(), mOrder.end());
+	for (int i = 0; i < static_cast<int>(mOrder.size()); i++)
+	{
+		mBlocks[mOrder[i]].rpo = i;
+	}
+}
+
+// Cooper, Harvey & Kennedy, "A Simple, Fast Dominance Algorithm": the idom
+// of a block is the common dominator of its processed predecessors, found by
+// walking up the current tree, repeated in reverse post-order until stable.
+void CFG::ComputeDominators()
+{
+	mDomChildren.assign(mBlocks.size(), std::vector<int>());
+	if (mOrder.empty())
+	{
+		return;
+	}
+
+	int entry = mOrder[0];
+	mBlocks[entry].idom = entry;
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t i = 1; i < mOrder.size(); i++)
+		{
+			int block = mOrder[i];
+			int newIdom = -1;
+			for (int pred : mBlocks[block].preds)
+			{
+				if (mBlocks[pred].idom < 0)
+				{
+					continue;
+				}
+				if (newIdom < 0)
+				{
+					newIdom = pred;
+					continue;
+				}
+				// intersect
+				int a = pred;
+				int b = newIdom;
+				while (a != b)
+				{
+					while (mBlocks[a].rpo > mBlocks[b].rpo)
+					{
+						a = mBlocks[a].idom;
+					}
+					while (mBlocks[b].rpo > mBlocks[a].rpo)
+					{
+						b = mBlocks[b].idom;
+					}
+				}
+				newIdom = a;
+			}
+			if (mBlocks[block].idom != newIdom)
+			{
+				mBlocks[block].idom = newIdom;
+				changed = true;
+			}
+		}
+	}
+	mBlocks[entry].idom = -1;
+
+	// number the dominator tree depth-first so Dominates is two compares
+	int numBlocks = GetNumBlocks();
+	std::vector<std::vector<int>>& children = mDomChildren;
+	for (int block : mOrder)
+	{
+		if (mBlocks[block].idom >= 0)
+		{
+			children[mBlocks[block].idom].emplace_back(block);
+		}
+	}
+	mDomPre.assign(numBlocks, -1);
+	mDomPost.assign(numBlocks, -1);
+	int counter = 0;
+	std::vector<std::pair<int, size_t>> stack;
+	stack.emplace_back(entry, 0);
+	mDomPre[entry] = counter++;
+	while (!stack.empty())
+	{
+		int block = stack.back().first;
+		size_t next = stack.back().second;
+		if (next < children[block].size())
+		{
+			stack.back().second++;
+			int child = children[block][next];
+			mDomPre[child] = counter++;
+			stack.emplace_back(child, 0);
+			continue;
+		}
+		mDomPost[block] = counter++;
+		stack.pop_back();
+	}
+}
+
+// A back edge goes from a latch to a header that dominates it; the loop is
+// every block that reaches the latch without going through the header.
+// Headers are taken innermost first, and the body is collected walking back
+// from the latches. A loop already found stands for all of its blocks: the
+// walk goes on from its header only (outer[] leads there), so each block is
+// walked once for the loop right around it rather than once per loop.
+void CFG::FindLoops()
+{
+	int numBlocks = GetNumBlocks();
+	// header of the outermost loop found so far around each block, or the
+	// block itself
+	std::vector<int> outer(numBlocks);
+	for (int b = 0; b < numBlocks; b++)
+	{
+		outer[b] = b;
+	}
+	auto findOuter = [&outer](int b) {
+		int root = b;
+		while (outer[root] != root)
+		{
+			root = outer[root];
+		}
+		while (outer[b] != root)
+		{
+			int next = outer[b];
+			outer[b] = root;
+			b = next;
+		}
+		return root;
+	};
+
+	// loops are numbered innermost first here and turned around at the end
+	std::vector<int> headerLoop(numBlocks, -1);
+	std::vector<int> mark(numBlocks, 0);
+	std::vector<int> work;
+	for (size_t i = mOrder.size(); i > 0; i--)
+	{
+		int header = mOrder[i - 1];
+		Loop loop;
+		loop.header = header;
+		for (int pred : mBlocks[header].preds)
+		{
+			if (Dominates(header, pred))
+			{
+				loop.latches.emplace_back(pred);
+			}
+		}
+		if (loop.latches.empty())
+		{
+			continue;
+		}
+
+		int number = GetNumLoops();
+		headerLoop[header] = number;
+		mBlocks[header].loop = number;
+		mark[header] = number + 1;
+		for (int latch : loop.latches)
+		{
+			work.emplace_back(findOuter(latch));
+		}
+		while (!work.empty())
+		{
+			int block = work.back();
+			work.pop_back();
+			if (mark[block] == number + 1)
+			{
+				continue;
+			}
+			mark[block] = number + 1;
+			outer[block] = header;
+			if (headerLoop[block] >= 0)
+			{
+				mLoops[headerLoop[block]].parent = number;
+			}
+			else
+			{
+				mBlocks[block].loop = number;
+			}
+			for (int pred : mBlocks[block].preds)
+			{
+				int from = findOuter(pred);
+				if (IsReachable(pred) && mark[from] != number + 1)
+				{
+					work.emplace_back(from);
+				}
+			}
+		}
+		mLoops.emplace_back(std::move(loop));
+	}
+
+	// outermost first; a parent is numbered before the loops in it
+	int numLoops = GetNumLoops();
+	std::reverse(mLoops.begin(), mLoops.end());
+	for (Loop& loop : mLoops)
+	{
+		if (loop.parent >= 0)
+		{
+			loop.parent = numLoops - 1 - loop.parent;
+			loop.depth = mLoops[loop.parent].depth + 1;
+		}
+	}
+	for (BasicBlock& block : mBlocks)
+	{
+		if (block.loop >= 0)
+		{
+			block.loop = numLoops - 1 - block.loop;
+			block.loopDepth = mLoops[block.loop].depth;
+		}
+	}
+}
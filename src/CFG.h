@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include "IR.h"
+
+// BasicBlock
+// a run of instructions that is only entered at the top and only left at
+// the bottom; ops [first, end) of the program's opsVector. A block starts at
+// a Label pseudo-op (or the program start, or after a jnt/jmp/exit).
+struct BasicBlock
+{
+	int first = 0;
+	int end = 0;
+
+	std::vector<int> preds;
+	// fall-through first, then the jump target
+	std::vector<int> succs;
+
+	// immediate dominator, -1 for the entry and unreachable blocks
+	int idom = -1;
+	// position in reverse post-order, -1 if unreachable
+	int rpo = -1;
+
+	// innermost loop containing the block (-1 if none) and how many loops do
+	int loop = -1;
+	int loopDepth = 0;
+};
+
+// Loop
+// a natural loop: the header dominates every block of it, and the latches
+// jump back to the header
+struct Loop
+{
+	int header = 0;
+	std::vector<int> latches;
+	// enclosing loop, -1 for an outermost loop
+	int parent = -1;
+	// 1 for an outermost loop
+	int depth = 1;
+};
+
+// CFG
+// basic blocks, edges, dominators and loop nesting of a program.
+// Jump targets are found through the movi that loads the label into the
+// jump's register, so the program has to be in the form CodeGen produces
+// (branch registers are virtual, not yet spilled or rewritten). The CFG
+// doesn't change the program; rebuild it after a pass edits the stream.
+class CFG
+{
+public:
+	CFG() = default;
+	explicit CFG(const CodeContext& program) { Build(program); }
+
+	void Build(const CodeContext& program);
+
+	int GetNumBlocks() const { return static_cast<int>(mBlocks.size()); }
+	const BasicBlock& GetBlock(int block) const { return mBlocks[block]; }
+	// block of the op at index in opsVector
+	int GetBlockOf(int index) const;
+	// block that starts at label id
+	int GetLabelBlock(int label) const { return mLabelBlock[label]; }
+
+	// reachable blocks, each one after all of its predecessors except
+	// along back edges
+	const std::vector<int>& GetReversePostOrder() const { return mOrder; }
+
+	bool IsReachable(int block) const { return mBlocks[block].rpo >= 0; }
+	// true if every path from the entry to b goes through a (a dominates itself)
+	bool Dominates(int a, int b) const;
+	// blocks whose immediate dominator is block
+	const std::vector<int>& GetDomChildren(int block) const { return mDomChildren[block]; }
+
+	// loops in order of their header's reverse post-order, so every loop
+	// comes before the loops nested in it
+	int GetNumLoops() const { return static_cast<int>(mLoops.size()); }
+	const Loop& GetLoop(int loop) const { return mLoops[loop]; }
+	bool IsLoopHeader(int block) const;
+
+private:
+	void SplitBlocks(const CodeContext& program);
+	void AddEdges(const CodeContext& program);
+	void ComputeOrder();
+	void ComputeDominators();
+	void FindLoops();
+
+	void AddEdge(int from, int to);
+
+	std::vector<BasicBlock> mBlocks;
+	std::vector<int> mLabelBlock;
+	std::vector<int> mOrder;
+	std::vector<Loop> mLoops;
+
+	// the dominator tree, and the pre/post-order numbers of each block in it
+	std::vector<std::vector<int>> mDomChildren;
+	std::vector<int> mDomPre;
+	std::vector<int> mDomPost;
+};
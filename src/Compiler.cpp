@@ -0,0 +1,206 @@
+#include "Compiler.h"
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <cstddef>
+#include <cstdlib>
+#include "Node.h"
+#include "PassManager.h"
+#include "Register.h"
+#include "ResolveContext.h"
+#include "ParseContext.h"
+#include "SourceBuffer.h"
+#include "TextWriter.h"
+
+typedef void* yyscan_t; // NOLINT
+extern int proccparse(yyscan_t scanner, ParseContext& ctx); // NOLINT
+extern int procclex_init_extra(ParseContext* extra, yyscan_t* scanner); // NOLINT
+struct yy_buffer_state; // NOLINT
+extern yy_buffer_state* procc_scan_buffer(char* base, size_t size, yyscan_t scanner); // NOLINT
+extern int procclex_destroy(yyscan_t scanner); // NOLINT
+
+namespace
+{
+	// reports an output file that couldn't be created
+	bool CheckOpen(const TextWriter& writer, const std::string& path, std::ostream& diag)
+	{
+		if (!writer.IsOpen())
+		{
+			diag << "Cannot write " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+void ParseModeOptions(const std::string& mode, CompileOptions& options)
+{
+	options.emit = mode.find("emit") != std::string::npos;
+	options.reg = mode.find("reg") != std::string::npos;
+	options.trace = mode.find("trace") != std::string::npos;
+	options.mappedOutput = mode.find("mmap") != std::string::npos;
+	options.timePasses = mode.find("time") != std::string::npos;
+	options.keepStores = mode.find("memory") != std::string::npos;
+
+	size_t level = mode.find("-O");
+	if (level != std::string::npos && level + 2 < mode.size()
+		&& mode[level + 2] >= '0' && mode[level + 2] <= '9')
+	{
+		options.optLevel = std::atoi(mode.c_str() + level + 2);
+	}
+}
+
+int CompileFile(const std::string& inputPath, const CompileOptions& options,
+	std::ostream& diag, CompileStats* stats)
+{
+	// Mapped rather than streamed: the scanner works on it in place and
+	// tokens in the AST point into it, so it stays open until we're done
+	SourceBuffer input;
+	if (!input.Open(inputPath))
+	{
+		diag << "File not found: " << inputPath << std::endl;
+		return 1;
+	}
+
+	// All state of this compilation lives here and in the scanner, nothing is global.
+	// Each thread keeps its own arena so repeated compilations reuse its blocks.
+	static thread_local Arena arena;
+	Ast ast(arena);
+	ParseContext ctx(ast);
+	ctx.trace = options.trace;
+	ctx.diag = &diag;
+
+	yyscan_t scanner = nullptr;
+	procclex_init_extra(&ctx, &scanner);
+	procc_scan_buffer(input.GetData(), input.GetScanSize(), scanner);
+
+	// Start the parse. This is handled by the Bison Parser. Checks Grammar.
+	proccparse(scanner, ctx);
+
+	CodeContext code;
+	bool semanticError = false;
+	// an output file couldn't be created; nothing after it is written
+	bool outputError = false;
+	if (ast.IsTooLarge())
+	{
+		diag << "ERROR: Program has more than " << NodeRef::kIndexMask + 1 << " nodes of one kind" << std::endl;
+		semanticError = true;
+	}
+	else if (ast.HasProgram())
+	{
+		// The stages run in order, each one working on the in-memory result
+		// of the previous one:
+		// parse -> AST dump -> name resolution -> code generation -> passes -> register allocation
+
+		// Part 2 - Generating the Abstract Syntax Tree.
+		// The Abstract Syntax Tree is the Intermediate Representation
+		if (!options.astPath.empty()) {
+			TextWriter file(options.astPath, options.mappedOutput);
+			if (CheckOpen(file, options.astPath, diag)) {
+				OutputAST(file, ast, ctx.symbols);
+			}
+			else {
+				outputError = true;
+			}
+		}
+
+		// Bind every name to its stack slot; codegen relies on it and
+		// doesn't run if a name is undeclared or declared twice
+		ResolveContext names(ctx.symbols, diag);
+		Resolve(ast, names);
+		semanticError = names.numErrors > 0;
+
+		if (!semanticError && !outputError)
+		{
+			// Part 3 - Generating assembly code with virtual registers.
+			// Done once, whichever later stages were asked for.
+			if (options.emit || options.reg) {
+				CodeGen(ast, code);
+			}
+
+			// Optimizations, whatever -O<n> selects. The analyses they leave
+			// behind are reused by register allocation.
+			PassManager passes(code);
+			if (options.emit || options.reg) {
+				passes.Add(GetPipeline(options.optLevel));
+				if (options.keepStores) {
+					passes.Remove("dse");
+				}
+				passes.Run();
+				if (options.timePasses) {
+					OutputPassStats(diag, passes.GetStats());
+				}
+			}
+
+			if (options.emit && !options.emitPath.empty()) {
+				TextWriter emit(options.emitPath, options.mappedOutput);
+				if (CheckOpen(emit, options.emitPath, diag)) {
+					OutputProgram(emit, code);
+				}
+				else {
+					outputError = true;
+				}
+			}
+
+			// Part 4 - register allocation with set # of registers (7)
+			if (options.reg && !outputError) {
+				Register reg1;
+
+				// generate intervals for registers from the program's liveness,
+				// then assign them
+				Analyses& analyses = passes.GetAnalyses();
+				reg1.GenerateIntervals(code, analyses.GetCFG(), analyses.GetLiveness());
+				reg1.LinearScan(code);
+
+				if (!options.regPath.empty()) {
+					TextWriter oreg(options.regPath, options.mappedOutput);
+					if (CheckOpen(oreg, options.regPath, diag)) {
+						reg1.OutputIntervals(oreg);
+						reg1.OutputAllocation(oreg);
+					}
+					else {
+						outputError = true;
+					}
+				}
+
+				// write the program with real registers
+				reg1.Rewrite(code);
+
+				if (!options.regEmitPath.empty() && !outputError) {
+					TextWriter emit(options.regEmitPath, options.mappedOutput);
+					if (CheckOpen(emit, options.regEmitPath, diag)) {
+						OutputProgram(emit, code);
+					}
+					else {
+						outputError = true;
+					}
+				}
+			}
+		}
+	}
+	else if (ctx.trace)
+	{
+		// (Just a useful separator for debug cout statements in grammar)
+		diag << "**********************************************\n";
+	}
+
+	if (stats != nullptr)
+	{
+		stats->lines = ctx.lineNumber - 1;
+		stats->instructions = LayoutProgram(code).numInstructions;
+	}
+
+	// Destroy this compilation's lexer (the source buffer is unmapped on return)
+	procclex_destroy(scanner);
+	// Release every node of this compilation
+	arena.Reset();
+	// Return 1 if syntax or name error or an output file couldn't be written, 0 otherwise
+	return static_cast<int>(ctx.syntaxError || semanticError || outputError);
+}
+
+void proccerror(yyscan_t /*scanner*/, ParseContext& ctx, const char* s) // NOLINT
+{
+	*ctx.diag << s << " on line " << ctx.lineNumber << std::endl;
+	ctx.syntaxError = true;
+}
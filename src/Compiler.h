@@ -0,0 +1,54 @@
+#pragma once
+#include <ostream>
+#include <string>
+
+// CompileOptions
+// which stages to run on one input and where their output goes;
+// an empty path means that output is not written
+struct CompileOptions
+{
+	// emit/reg stages
+	bool emit = false;
+	bool reg = false;
+
+	// echo grammar reductions to the diagnostics stream
+	bool trace = false;
+
+	// write the output files through a memory mapping instead of a stream
+	bool mappedOutput = false;
+
+	// optimization pipeline run on the generated code (-O0, -O1, -O2)
+	int optLevel = 0;
+	// report the time and instruction delta of every pass to diag
+	bool timePasses = false;
+	// keep every store to a variable, so memory holds the same values as
+	// at -O0 after every instruction rather than only at the end
+	bool keepStores = false;
+
+	std::string astPath;
+	// program with virtual registers
+	std::string emitPath;
+	// intervals/allocation and the program with real registers
+	std::string regPath;
+	std::string regEmitPath;
+};
+
+// sets the stage and flag options from the words of a mode string ("emit",
+// "reg", "trace", "mmap", "time", "memory", "-O<n>"), leaving the paths alone
+void ParseModeOptions(const std::string& mode, CompileOptions& options);
+
+// CompileStats
+// what one compilation got through, for throughput reporting
+struct CompileStats
+{
+	int lines = 0;
+	int instructions = 0;
+};
+
+// Compiles one file: parse -> AST dump -> code generation -> optimization
+// passes -> register allocation.
+// Syntax errors, traces and output files that can't be created go to diag.
+// Returns 0 on success, 1 otherwise.
+// Safe to call from several threads at once as long as the output paths differ.
+int CompileFile(const std::string& inputPath, const CompileOptions& options,
+	std::ostream& diag, CompileStats* stats = nullptr);
@@ -0,0 +1,250 @@
+#include "DeadCode.h"
+#include "CFG.h"
+#include <cstddef>
+
+namespace
+{
+	// ops that can go if nothing reads the VR they write
+	bool IsPure(const Ops& ops)
+	{
+		switch (ops.op)
+		{
+		case OpCode::Movi:
+		case OpCode::Mov:
+		case OpCode::Loadi:
+		case OpCode::Load:
+		case OpCode::Add:
+		case OpCode::Sub:
+		case OpCode::Mul:
+		case OpCode::Inc:
+		case OpCode::Dec:
+		case OpCode::Phi:
+			return ops.params[0].IsVReg();
+		default:
+			return false;
+		}
+	}
+
+	// a read or store of a scalar slot
+	struct Access
+	{
+		int index;
+		int block;
+		bool store;
+	};
+}
+
+// Mark and sweep: the ops that aren't pure are live, and so is every def of
+// a VR a live op reads.
+bool RemoveDeadCode(CodeContext& program)
+{
+	int numOps = static_cast<int>(program.opsVector.size());
+
+	// defs of each VR, as a list per VR in one array
+	std::vector<int> defStart(program.lastVRegIndex + 1, 0);
+	for (const Ops& ops : program.opsVector)
+	{
+		if (IsPure(ops))
+		{
+			defStart[ops.params[0].value + 1]++;
+		}
+	}
+	for (int v = 0; v < program.lastVRegIndex; v++)
+	{
+		defStart[v + 1] += defStart[v];
+	}
+	std::vector<int> defs(defStart.back());
+	std::vector<int> next(defStart.begin(), defStart.end() - 1);
+	for (int i = 0; i < numOps; i++)
+	{
+		const Ops& ops = program.opsVector[i];
+		if (IsPure(ops))
+		{
+			defs[next[ops.params[0].value]++] = i;
+		}
+	}
+
+	std::vector<bool> live(numOps, false);
+	std::vector<bool> liveVReg(program.lastVRegIndex, false);
+	std::vector<int> work;
+	auto markUse = [&](const Operand& operand) {
+		if (!operand.IsVReg() || liveVReg[operand.value])
+		{
+			return;
+		}
+		liveVReg[operand.value] = true;
+		for (int d = defStart[operand.value]; d < defStart[operand.value + 1]; d++)
+		{
+			if (!live[defs[d]])
+			{
+				live[defs[d]] = true;
+				work.emplace_back(defs[d]);
+			}
+		}
+	};
+
+	for (int i = 0; i < numOps; i++)
+	{
+		if (!IsPure(program.opsVector[i]))
+		{
+			live[i] = true;
+			work.emplace_back(i);
+		}
+	}
+	while (!work.empty())
+	{
+		const Ops& ops = program.opsVector[work.back()];
+		work.pop_back();
+		if (ops.op == OpCode::Phi)
+		{
+			for (const PhiArg& arg : program.phis[ops.params[1].value].args)
+			{
+				markUse(arg.value);
+			}
+			continue;
+		}
+		for (int j = 0; j < ops.numParams; j++)
+		{
+			if (IsUse(ops, j))
+			{
+				markUse(ops.params[j]);
+			}
+		}
+	}
+
+	int kept = 0;
+	for (int i = 0; i < numOps; i++)
+	{
+		if (live[i])
+		{
+			program.opsVector[kept++] = program.opsVector[i];
+		}
+	}
+	program.opsVector.erase(program.opsVector.begin() + kept, program.opsVector.end());
+	return kept != numOps;
+}
+
+// Each slot is followed back from the blocks that read it before storing
+// it, through the predecessors, until blocks that store it; that gives the
+// blocks the slot is live out of. A store is dead if the next access in its
+// block is another store, or if there is none and the slot isn't live out.
+bool RemoveDeadStores(CodeContext& program, const CFG& cfg)
+{
+	int numSlots = static_cast<int>(program.arraySlots.size());
+	int numBlocks = cfg.GetNumBlocks();
+
+	std::vector<bool> stored(numSlots, false);
+	std::vector<int> storedSlots;
+	for (const Ops& ops : program.opsVector)
+	{
+		if (ops.op == OpCode::Storei && program.IsScalarSlot(ops.params[0]) && !stored[ops.params[0].value])
+		{
+			stored[ops.params[0].value] = true;
+			storedSlots.emplace_back(ops.params[0].value);
+		}
+	}
+	if (storedSlots.empty())
+	{
+		return false;
+	}
+
+	// accesses of each stored slot in program order
+	std::vector<std::vector<Access>> accesses(numSlots);
+	for (int b = 0; b < numBlocks; b++)
+	{
+		const BasicBlock& block = cfg.GetBlock(b);
+		for (int i = block.first; i < block.end; i++)
+		{
+			const Ops& ops = program.opsVector[i];
+			if (ops.op == OpCode::Storei && program.IsScalarSlot(ops.params[0]))
+			{
+				accesses[ops.params[0].value].emplace_back(Access{ i, b, true });
+			}
+			else if (ops.op == OpCode::Loadi && program.IsScalarSlot(ops.params[1]) && stored[ops.params[1].value])
+			{
+				accesses[ops.params[1].value].emplace_back(Access{ i, b, false });
+			}
+			else if (ops.op == OpCode::Exit)
+			{
+				for (int slot : storedSlots)
+				{
+					accesses[slot].emplace_back(Access{ i, b, false });
+				}
+			}
+		}
+	}
+
+	// marks hold slot + 1
+	std::vector<int> kills(numBlocks, 0);
+	std::vector<int> liveIn(numBlocks, 0);
+	std::vector<int> liveOut(numBlocks, 0);
+	std::vector<int> work;
+	std::vector<bool> removed(program.opsVector.size(), false);
+	bool changed = false;
+	for (int slot : storedSlots)
+	{
+		const std::vector<Access>& list = accesses[slot];
+		int mark = slot + 1;
+		for (size_t k = 0; k < list.size(); k++)
+		{
+			bool first = k == 0 || list[k - 1].block != list[k].block;
+			if (list[k].store)
+			{
+				kills[list[k].block] = mark;
+			}
+			else if (first && liveIn[list[k].block] != mark && cfg.IsReachable(list[k].block))
+			{
+				liveIn[list[k].block] = mark;
+				work.emplace_back(list[k].block);
+			}
+		}
+
+		while (!work.empty())
+		{
+			int b = work.back();
+			work.pop_back();
+			for (int pred : cfg.GetBlock(b).preds)
+			{
+				if (liveOut[pred] == mark || !cfg.IsReachable(pred))
+				{
+					continue;
+				}
+				liveOut[pred] = mark;
+				if (kills[pred] != mark && liveIn[pred] != mark)
+				{
+					liveIn[pred] = mark;
+					work.emplace_back(pred);
+				}
+			}
+		}
+
+		for (size_t k = 0; k < list.size(); k++)
+		{
+			if (!list[k].store)
+			{
+				continue;
+			}
+			bool last = k + 1 == list.size() || list[k + 1].block != list[k].block;
+			bool live = last ? liveOut[list[k].block] == mark : !list[k + 1].store;
+			if (!live)
+			{
+				removed[list[k].index] = true;
+				changed = true;
+			}
+		}
+	}
+
+	if (changed)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < removed.size(); i++)
+		{
+			if (!removed[i])
+			{
+				program.opsVector[kept++] = program.opsVector[i];
+			}
+		}
+		program.opsVector.erase(program.opsVector.begin() + kept, program.opsVector.end());
+	}
+	return changed;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "IR.h"
+
+class CFG;
+
+// Dead code elimination
+// removes the instructions whose only effect is to write virtual registers
+// nobody reads. Everything else (stores, output, branches, compares, and
+// div, which can trap) is kept, along with every instruction that computes
+// a value it reads. Works in and out of SSA form; a VR changed in place by
+// inc/dec is kept or removed with all of its defs.
+
+// returns true if anything was removed
+bool RemoveDeadCode(CodeContext& program);
+
+// Dead store elimination
+// removes the storei's to scalar variables that nothing can read before the
+// slot is stored again. Only loadi reads a scalar slot (arrays are only ever
+// reached through their own slots) and exit reads them all: the memory left
+// at the end of the program is the part of it that is observed. Run on SSA
+// form this keeps just the final stores BuildSSA puts before each exit.
+
+// returns true if anything was removed; cfg is the program's CFG
+bool RemoveDeadStores(CodeContext& program, const CFG& cfg);
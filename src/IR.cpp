@@ -0,0 +1,164 @@
+#include "IR.h"
+#include <cstring>
+#include "TextWriter.h"
+
+// This file prints the IR in the text format used by emit.txt and reg.txt
+
+namespace
+{
+	struct Mnemonic
+	{
+		const char* text;
+		size_t length;
+	};
+
+	// mnemonic for each opcode with its length, in OpCode order
+	#define MNEMONIC(text) { text, sizeof(text) - 1 }
+	const Mnemonic kMnemonics[] = {
+		MNEMONIC("push"),
+		MNEMONIC("movi"),
+		MNEMONIC("mov"),
+		MNEMONIC("loadi"),
+		MNEMONIC("storei"),
+		MNEMONIC("load"),
+		MNEMONIC("store"),
+		MNEMONIC("add"),
+		MNEMONIC("sub"),
+		MNEMONIC("mul"),
+		MNEMONIC("div"),
+		MNEMONIC("inc"),
+		MNEMONIC("dec"),
+		MNEMONIC("cmpeq"),
+		MNEMONIC("cmplt"),
+		MNEMONIC("jnt"),
+		MNEMONIC("jmp"),
+		MNEMONIC("penup"),
+		MNEMONIC("pendown"),
+		MNEMONIC("fwd"),
+		MNEMONIC("back"),
+		MNEMONIC("exit"),
+		MNEMONIC("label"),
+		MNEMONIC("phi"),
+	};
+	#undef MNEMONIC
+
+	// longest line: "pendown" and three operands of at most "%" + 11 digits
+	const size_t kMaxLineLength = 64;
+
+	// writes operand at p, returns the end of it
+	char* FormatOperand(char* p, const Operand& operand)
+	{
+		static const char special[][2] = { { 't', 'x' }, { 't', 'y' }, { 't', 'c' }, { 't', 'r' } };
+
+		switch (operand.kind)
+		{
+		case OperandKind::VReg:
+			*p++ = '%';
+			return TextWriter::FormatInt(p, operand.value);
+		case OperandKind::PhysReg:
+			*p++ = 'r';
+			return TextWriter::FormatInt(p, operand.value);
+		case OperandKind::Special:
+			*p++ = special[operand.value][0];
+			*p++ = special[operand.value][1];
+			return p;
+		case OperandKind::Imm:
+		case OperandKind::Stack:
+		case OperandKind::Label:
+			return TextWriter::FormatInt(p, operand.value);
+		default:
+			return p;
+		}
+	}
+}
+
+// operand roles for each opcode, in OpCode order
+const OpInfo& GetOpInfo(OpCode op)
+{
+	static const OpInfo info[] = {
+		{ 0x1, 0x0 },	// push src
+		{ 0x0, 0x1 },	// movi dst,imm
+		{ 0x2, 0x1 },	// mov dst,src
+		{ 0x0, 0x1 },	// loadi dst,slot
+		{ 0x2, 0x0 },	// storei slot,src
+		{ 0x2, 0x1 },	// load dst,addr
+		{ 0x3, 0x0 },	// store addr,src
+		{ 0x6, 0x1 },	// add dst,a,b
+		{ 0x6, 0x1 },	// sub dst,a,b
+		{ 0x6, 0x1 },	// mul dst,a,b
+		{ 0x6, 0x1 },	// div dst,a,b
+		{ 0x1, 0x1 },	// inc reg
+		{ 0x1, 0x1 },	// dec reg
+		{ 0x3, 0x0 },	// cmpeq a,b
+		{ 0x3, 0x0 },	// cmplt a,b
+		{ 0x1, 0x0 },	// jnt target
+		{ 0x1, 0x0 },	// jmp target
+		{ 0x0, 0x0 },	// penup
+		{ 0x0, 0x0 },	// pendown
+		{ 0x1, 0x0 },	// fwd src
+		{ 0x1, 0x0 },	// back src
+		{ 0x0, 0x0 },	// exit
+		{ 0x0, 0x0 },	// label id
+		{ 0x0, 0x1 },	// phi dst,index
+	};
+	return info[static_cast<int>(op)];
+}
+
+// one instruction per line, operands separated by commas; the whole line is
+// formatted in place in the writer's buffer
+void OutputOps(TextWriter& out, const Ops& ops)
+{
+	char* p = out.Reserve(kMaxLineLength);
+	const Mnemonic& name = kMnemonics[static_cast<int>(ops.op)];
+	std::memcpy(p, name.text, name.length);
+	p += name.length;
+	for (int i = 0; i < ops.numParams; i++)
+	{
+		*p++ = (i == 0 ? ' ' : ',');
+		p = FormatOperand(p, ops.params[i]);
+	}
+	*p++ = '\n';
+	out.Commit(p);
+}
+
+// label positions, counting only real instructions
+Layout LayoutProgram(const CodeContext& context)
+{
+	Layout layout;
+	layout.labelIndex.assign(context.lastLabelIndex, -1);
+	for (auto& ops : context.opsVector)
+	{
+		if (ops.op == OpCode::Label)
+		{
+			layout.labelIndex[ops.params[0].value] = layout.numInstructions;
+		}
+		else
+		{
+			layout.numInstructions++;
+		}
+	}
+	return layout;
+}
+
+// whole instruction stream, in its final layout: Label pseudo-ops are
+// dropped and every label operand is fixed up to its instruction index
+void OutputProgram(TextWriter& out, const CodeContext& context)
+{
+	Layout layout = LayoutProgram(context);
+	for (auto& ops : context.opsVector)
+	{
+		if (ops.op == OpCode::Label)
+		{
+			continue;
+		}
+		Ops line = ops;
+		for (int i = 0; i < line.numParams; i++)
+		{
+			if (line.params[i].kind == OperandKind::Label)
+			{
+				line.params[i].value = layout.labelIndex[line.params[i].value];
+			}
+		}
+		OutputOps(out, line);
+	}
+}
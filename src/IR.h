@@ -0,0 +1,219 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class TextWriter;
+
+// OpCode
+// every instruction the code generator can produce
+enum class OpCode : uint8_t
+{
+	Push,
+	Movi,
+	Mov,
+	Loadi,
+	Storei,
+	Load,
+	Store,
+	Add,
+	Sub,
+	Mul,
+	Div,
+	Inc,
+	Dec,
+	Cmpeq,
+	Cmplt,
+	Jnt,
+	Jmp,
+	PenUp,
+	PenDown,
+	Fwd,
+	Back,
+	Exit,
+	// pseudo-op marking the position of params[0]'s label, takes no space
+	// in the final program
+	Label,
+	// SSA pseudo-op at the top of a block: params[0] = value of the stack
+	// slot of CodeContext::phis[params[1]] on entry, see SSA.h
+	Phi,
+};
+
+// OperandKind
+// tells how the value of an Operand should be read
+enum class OperandKind : uint8_t
+{
+	None,
+	VReg,		// virtual register id (%N)
+	PhysReg,	// physical register number (rN)
+	Special,	// one of the turtle registers, see SpecialReg
+	Imm,		// immediate integer
+	Stack,		// stack slot index
+	Label,		// label id used as a branch target, see Layout
+};
+
+// SpecialReg
+// the turtle registers that can be written by mov/add
+enum class SpecialReg : int32_t
+{
+	Tx,
+	Ty,
+	Tc,
+	Tr,
+};
+
+// Operand Struct
+// a tagged 32-bit value stored inline in an instruction
+struct Operand
+{
+	OperandKind kind = OperandKind::None;
+	int32_t value = 0;
+
+	Operand() = default;
+	Operand(OperandKind k, int32_t v)
+		:kind(k)
+		,value(v)
+	{ }
+
+	static Operand VReg(int id) { return Operand(OperandKind::VReg, id); }
+	static Operand PhysReg(int num) { return Operand(OperandKind::PhysReg, num); }
+	static Operand Special(SpecialReg reg) { return Operand(OperandKind::Special, static_cast<int32_t>(reg)); }
+	static Operand Imm(int val) { return Operand(OperandKind::Imm, val); }
+	static Operand Stack(int slot) { return Operand(OperandKind::Stack, slot); }
+	static Operand Label(int id) { return Operand(OperandKind::Label, id); }
+
+	bool IsVReg() const { return kind == OperandKind::VReg; }
+};
+
+// Operations Struct
+// a single instruction: an opcode plus up to three inline operands
+struct Ops
+{
+	static const int kMaxParams = 3;
+
+	OpCode op;
+	uint8_t numParams = 0;
+	Operand params[kMaxParams];
+
+	explicit Ops(OpCode code)
+		:op(code)
+	{ }
+	Ops(OpCode code, Operand a)
+		:op(code)
+	{
+		AddParam(a);
+	}
+	Ops(OpCode code, Operand a, Operand b)
+		:op(code)
+	{
+		AddParam(a);
+		AddParam(b);
+	}
+	Ops(OpCode code, Operand a, Operand b, Operand c)
+		:op(code)
+	{
+		AddParam(a);
+		AddParam(b);
+		AddParam(c);
+	}
+
+	void AddParam(Operand param) { params[numParams++] = param; }
+};
+
+// PhiArg
+// value a phi takes when its block is entered from pred, the label id of the
+// predecessor block (every block has a label while the program is in SSA form)
+struct PhiArg
+{
+	int pred;
+	Operand value;
+};
+
+// Phi
+// operands of one phi; the phi itself is an Ops(OpCode::Phi, dst, index)
+struct Phi
+{
+	int slot;
+	std::vector<PhiArg> args;
+};
+
+// CodeContext
+// contains the data needed to store instructions and
+// track locations of variables/arrays on stack
+struct CodeContext
+{
+	//  vector to store generated instructions
+	std::vector<Ops> opsVector;
+
+	// count of the last virtual register index used
+	int lastVRegIndex = 0;
+
+	// count of the last stack index used
+	int lastStackIndex = 0;
+
+	// count of the last label id used
+	int lastLabelIndex = 0;
+
+	// true for the stack slots of array elements (set by CodeGen), which are
+	// reached through computed addresses; the others hold scalar variables
+	std::vector<bool> arraySlots;
+
+	// operands of the Phi pseudo-ops while the program is in SSA form
+	std::vector<Phi> phis;
+
+	CodeContext() = default;
+
+	// hands out the next unused virtual register
+	Operand NewVReg() { return Operand::VReg(lastVRegIndex++); }
+
+	// appends an instruction and returns its index
+	int Emit(const Ops& ops)
+	{
+		opsVector.emplace_back(ops);
+		return static_cast<int>(opsVector.size()) - 1;
+	}
+
+	// true if operand is the stack slot of a scalar variable
+	bool IsScalarSlot(const Operand& operand) const
+	{
+		return operand.kind == OperandKind::Stack
+			&& operand.value < static_cast<int>(arraySlots.size())
+			&& !arraySlots[operand.value];
+	}
+
+	// hands out the next unused label; it can be jumped to before it is placed
+	Operand NewLabel() { return Operand::Label(lastLabelIndex++); }
+
+	// marks the position of label: the next instruction emitted
+	void PlaceLabel(Operand label) { Emit(Ops(OpCode::Label, label)); }
+};
+
+// Layout
+// where everything ends up in the final program. Branch targets stay
+// symbolic while the program is generated and rewritten (spill code, later
+// passes), so instructions can be inserted or removed freely; only the
+// output resolves each label to the index of the instruction after it.
+struct Layout
+{
+	// final instruction index of each label id
+	std::vector<int> labelIndex;
+	// instructions in the final program (Label pseudo-ops left out)
+	int numInstructions = 0;
+};
+Layout LayoutProgram(const CodeContext& context);
+
+// which operand positions an opcode reads and writes
+// (bit i set = params[i]); inc/dec both read and write params[0]
+struct OpInfo
+{
+	uint8_t useMask;
+	uint8_t defMask;
+};
+const OpInfo& GetOpInfo(OpCode op);
+
+inline bool IsUse(const Ops& ops, int index) { return (GetOpInfo(ops.op).useMask >> index) & 1; }
+inline bool IsDef(const Ops& ops, int index) { return (GetOpInfo(ops.op).defMask >> index) & 1; }
+
+// Text form of the IR (the emit.txt format). OutputOps writes label operands
+// as they are; OutputProgram lays the program out and writes the targets.
+void OutputOps(TextWriter& out, const Ops& ops);
+void OutputProgram(TextWriter& out, const CodeContext& context);
@@ -0,0 +1,500 @@
+#include "LICM.h"
+#include "CFG.h"
+#include "Liveness.h"
+#include "Register.h"
+#include <utility>
+
+// The blocks are visited in reverse post-order, so the defs of an
+// instruction's operands (which dominate it) have been placed before it is.
+// loc[vr] is the innermost loop the def of vr ends up in, -1 for none.
+
+namespace
+{
+	class LoopInvariantMotion
+	{
+	public:
+		LoopInvariantMotion(CodeContext& program, const CFG& cfg, const Liveness& liveness)
+			:mProgram(program)
+			,mCfg(cfg)
+			,mLiveness(liveness)
+		{ }
+
+		bool Run();
+
+	private:
+		void NumberLoops();
+		void FindPreheaders();
+		void FindDefsAndStores();
+		void FindRegisterBudgets();
+		bool CanLeave(const Ops& ops, int loop, bool inHeader) const;
+		void Rewrite();
+
+		// true if loop a is inner (or equal to) loop b
+		bool IsWithin(int a, int b) const
+		{
+			return a >= 0 && mPre[b] <= mPre[a] && mPost[a] <= mPost[b];
+		}
+
+		// ops that can move if their operands allow it
+		bool IsMovable(const Ops& ops) const
+		{
+			switch (ops.op)
+			{
+			case OpCode::Movi:
+			case OpCode::Mov:
+			case OpCode::Loadi:
+			case OpCode::Load:
+			case OpCode::Add:
+			case OpCode::Sub:
+			case OpCode::Mul:
+				return ops.params[0].IsVReg() && mDefCount[ops.params[0].value] == 1;
+			default:
+				return false;
+			}
+		}
+
+		CodeContext& mProgram;
+		const CFG& mCfg;
+		const Liveness& mLiveness;
+
+		// pre/post-order numbers of the loops in the loop nesting tree
+		std::vector<int> mPre;
+		std::vector<int> mPost;
+
+		// block of the only outside predecessor of each loop, -1 if the
+		// loop can't have a preheader
+		std::vector<int> mEntry;
+		std::vector<int> mDefCount;
+		std::vector<int> mLoc;
+		// loops with a store, and the blocks storing to each slot
+		std::vector<bool> mHasStore;
+		std::vector<std::vector<int>> mSlotStores;
+
+		// values that can still be kept live through each loop without
+		// running out of registers
+		std::vector<int> mBudget;
+
+		// instructions moved to each loop's preheader, in order
+		std::vector<std::vector<int>> mHoisted;
+		std::vector<bool> mMoved;
+	};
+
+	bool LoopInvariantMotion::Run()
+	{
+		int numLoops = mCfg.GetNumLoops();
+		if (numLoops == 0)
+		{
+			return false;
+		}
+
+		NumberLoops();
+		FindPreheaders();
+		FindDefsAndStores();
+		FindRegisterBudgets();
+
+		mHoisted.assign(numLoops, std::vector<int>());
+		mMoved.assign(mProgram.opsVector.size(), false);
+		bool changed = false;
+		for (int b : mCfg.GetReversePostOrder())
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			for (int i = block.first; i < block.end; i++)
+			{
+				const Ops& ops = mProgram.opsVector[i];
+				if (block.loop < 0 || !IsMovable(ops))
+				{
+					continue;
+				}
+
+				// out of the innermost loop, then the ones around it; the
+				// value is then live all through each of them
+				int target = -1;
+				bool inHeader = mCfg.IsLoopHeader(b);
+				for (int loop = block.loop; loop >= 0 && mBudget[loop] > 0 && CanLeave(ops, loop, inHeader);
+					loop = mCfg.GetLoop(loop).parent)
+				{
+					target = loop;
+					inHeader = false;
+				}
+				if (target >= 0)
+				{
+					for (int loop = block.loop; loop != mCfg.GetLoop(target).parent; loop = mCfg.GetLoop(loop).parent)
+					{
+						mBudget[loop]--;
+					}
+					mHoisted[target].emplace_back(i);
+					mMoved[i] = true;
+					mLoc[ops.params[0].value] = mCfg.GetLoop(target).parent;
+					changed = true;
+				}
+			}
+		}
+
+		if (changed)
+		{
+			Rewrite();
+		}
+		return changed;
+	}
+
+	// so that IsWithin doesn't have to walk up the parents
+	void LoopInvariantMotion::NumberLoops()
+	{
+		int numLoops = mCfg.GetNumLoops();
+		std::vector<std::vector<int>> children(numLoops);
+		std::vector<int> roots;
+		for (int loop = 0; loop < numLoops; loop++)
+		{
+			int parent = mCfg.GetLoop(loop).parent;
+			if (parent >= 0)
+			{
+				children[parent].emplace_back(loop);
+			}
+			else
+			{
+				roots.emplace_back(loop);
+			}
+		}
+
+		mPre.assign(numLoops, -1);
+		mPost.assign(numLoops, -1);
+		int counter = 0;
+		std::vector<std::pair<int, size_t>> stack;
+		for (int root : roots)
+		{
+			mPre[root] = counter++;
+			stack.emplace_back(root, 0);
+			while (!stack.empty())
+			{
+				int loop = stack.back().first;
+				size_t next = stack.back().second;
+				if (next < children[loop].size())
+				{
+					stack.back().second++;
+					int child = children[loop][next];
+					mPre[child] = counter++;
+					stack.emplace_back(child, 0);
+					continue;
+				}
+				mPost[loop] = counter++;
+				stack.pop_back();
+			}
+		}
+	}
+
+	// the loop must be entered only by falling through from the block
+	// before the header, which the preheader then goes between
+	void LoopInvariantMotion::FindPreheaders()
+	{
+		mEntry.assign(mCfg.GetNumLoops(), -1);
+		for (int loop = 0; loop < mCfg.GetNumLoops(); loop++)
+		{
+			int header = mCfg.GetLoop(loop).header;
+			int entry = -1;
+			int numEntries = 0;
+			for (int pred : mCfg.GetBlock(header).preds)
+			{
+				if (!IsWithin(mCfg.GetBlock(pred).loop, loop))
+				{
+					entry = pred;
+					numEntries++;
+				}
+			}
+			if (numEntries != 1 || entry != header - 1)
+			{
+				continue;
+			}
+
+			const BasicBlock& block = mCfg.GetBlock(entry);
+			OpCode last = mProgram.opsVector[block.end - 1].op;
+			// a jnt's jump must go elsewhere
+			if (last == OpCode::Jmp || (last == OpCode::Jnt
+				&& (block.succs.size() != 2 || block.succs[1] == header)))
+			{
+				continue;
+			}
+			mEntry[loop] = entry;
+		}
+	}
+
+	void LoopInvariantMotion::FindDefsAndStores()
+	{
+		mDefCount.assign(mProgram.lastVRegIndex, 0);
+		mLoc.assign(mProgram.lastVRegIndex, -1);
+		mHasStore.assign(mCfg.GetNumLoops(), false);
+		mSlotStores.assign(mProgram.arraySlots.size(), std::vector<int>());
+		for (int b = 0; b < mCfg.GetNumBlocks(); b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			for (int i = block.first; i < block.end; i++)
+			{
+				const Ops& ops = mProgram.opsVector[i];
+				for (int j = 0; j < ops.numParams; j++)
+				{
+					if (ops.params[j].IsVReg() && IsDef(ops, j))
+					{
+						mDefCount[ops.params[j].value]++;
+						mLoc[ops.params[j].value] = block.loop;
+					}
+				}
+				if (ops.op == OpCode::Store && block.loop >= 0)
+				{
+					mHasStore[block.loop] = true;
+				}
+				else if (ops.op == OpCode::Storei && mProgram.IsScalarSlot(ops.params[0]))
+				{
+					mSlotStores[ops.params[0].value].emplace_back(b);
+				}
+			}
+		}
+
+		// a store in a loop is in every loop around it; inner loops come
+		// after the loops they are in
+		for (int loop = mCfg.GetNumLoops() - 1; loop >= 0; loop--)
+		{
+			int parent = mCfg.GetLoop(loop).parent;
+			if (mHasStore[loop] && parent >= 0)
+			{
+				mHasStore[parent] = true;
+			}
+		}
+	}
+
+	// Every value moved out of a loop takes a register for the whole loop.
+	// Once more values are live than there are registers the allocator
+	// spills, and keeps registers back for the spill code, which costs more
+	// than the instructions saved; so each loop only takes as many values
+	// as it has registers to spare at its busiest point. The ones spill code
+	// would need are only left alone if the program might spill anyway.
+	void LoopInvariantMotion::FindRegisterBudgets()
+	{
+		std::vector<int> live(mProgram.lastVRegIndex, 0);
+		std::vector<int> pinned(mProgram.lastVRegIndex, 0);
+		int stamp = 0;
+		// the most values live at once in each loop, then what's left
+		mBudget.assign(mCfg.GetNumLoops(), 0);
+		int busiest = 0;
+		for (int b = 0; b < mCfg.GetNumBlocks(); b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+
+			// VRs live after each instruction, walking up from the block end
+			stamp++;
+			int count = 0;
+			auto addLive = [&](int vreg) {
+				if (live[vreg] != stamp)
+				{
+					live[vreg] = stamp;
+					count++;
+				}
+			};
+			mLiveness.ForEachLiveOut(b, addLive);
+			// liveness doesn't see phis: their args are read at the end of
+			// the block they come from
+			const Ops& first = mProgram.opsVector[block.first];
+			for (int succ : block.succs)
+			{
+				const BasicBlock& next = mCfg.GetBlock(succ);
+				for (int i = next.first; i < next.end && first.op == OpCode::Label; i++)
+				{
+					const Ops& ops = mProgram.opsVector[i];
+					if (ops.op != OpCode::Phi)
+					{
+						continue;
+					}
+					for (const PhiArg& arg : mProgram.phis[ops.params[1].value].args)
+					{
+						if (arg.pred == first.params[0].value && arg.value.IsVReg())
+						{
+							addLive(arg.value.value);
+						}
+					}
+				}
+			}
+			// the allocator gives each VR one interval, so whatever is live
+			// into the loop header or set by its phis holds its register
+			// through the whole loop
+			if (block.loop >= 0)
+			{
+				const BasicBlock& header = mCfg.GetBlock(mCfg.GetLoop(block.loop).header);
+				auto pin = [&](int vreg) {
+					pinned[vreg] = stamp;
+					addLive(vreg);
+				};
+				mLiveness.ForEachLiveIn(mCfg.GetLoop(block.loop).header, pin);
+				for (int i = header.first; i < header.end; i++)
+				{
+					const Ops& ops = mProgram.opsVector[i];
+					if (ops.op == OpCode::Phi && ops.params[0].IsVReg())
+					{
+						pin(ops.params[0].value);
+					}
+				}
+			}
+			int pressure = count;
+			for (int i = block.end - 1; i >= block.first; i--)
+			{
+				const Ops& ops = mProgram.opsVector[i];
+				for (int j = 0; j < ops.numParams; j++)
+				{
+					if (ops.params[j].IsVReg() && IsDef(ops, j) && !IsUse(ops, j) && live[ops.params[j].value] == stamp
+						&& pinned[ops.params[j].value] != stamp)
+					{
+						live[ops.params[j].value] = 0;
+						count--;
+					}
+				}
+				for (int j = 0; j < ops.numParams; j++)
+				{
+					if (ops.params[j].IsVReg() && IsUse(ops, j) && live[ops.params[j].value] != stamp)
+					{
+						live[ops.params[j].value] = stamp;
+						count++;
+					}
+				}
+				pressure = pressure > count ? pressure : count;
+			}
+
+			busiest = busiest > pressure ? busiest : pressure;
+			if (block.loop >= 0 && mBudget[block.loop] < pressure)
+			{
+				mBudget[block.loop] = pressure;
+			}
+		}
+
+		// a loop is as busy as the busiest loop in it
+		for (int loop = mCfg.GetNumLoops() - 1; loop >= 0; loop--)
+		{
+			int parent = mCfg.GetLoop(loop).parent;
+			if (parent >= 0 && mBudget[loop] > mBudget[parent])
+			{
+				mBudget[parent] = mBudget[loop];
+			}
+		}
+
+		// out of SSA form the intervals overlap more than the values live
+		// here, so only a program that fits beside the scratch registers
+		// everywhere is sure not to spill and can let loops have them too
+		int numRegisters = Register::kNumRegisters;
+		if (busiest > Register::kNumRegisters - Register::kNumScratch)
+		{
+			numRegisters -= Register::kNumScratch;
+		}
+		for (int& budget : mBudget)
+		{
+			budget = numRegisters - budget;
+		}
+	}
+
+	bool LoopInvariantMotion::CanLeave(const Ops& ops, int loop, bool inHeader) const
+	{
+		if (mEntry[loop] < 0)
+		{
+			return false;
+		}
+		if (ops.op == OpCode::Load && (!inHeader || mHasStore[loop]))
+		{
+			return false;
+		}
+		if (ops.op == OpCode::Loadi)
+		{
+			if (!inHeader || !mProgram.IsScalarSlot(ops.params[1]))
+			{
+				return false;
+			}
+			for (int b : mSlotStores[ops.params[1].value])
+			{
+				if (IsWithin(mCfg.GetBlock(b).loop, loop))
+				{
+					return false;
+				}
+			}
+		}
+
+		for (int j = 0; j < ops.numParams; j++)
+		{
+			const Operand& param = ops.params[j];
+			if (!IsUse(ops, j))
+			{
+				continue;
+			}
+			if (!param.IsVReg())
+			{
+				// the turtle registers change whenever the turtle moves
+				if (param.kind == OperandKind::Special || param.kind == OperandKind::PhysReg)
+				{
+					return false;
+				}
+				continue;
+			}
+			if (mDefCount[param.value] != 1 || IsWithin(mLoc[param.value], loop))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// each preheader goes right before its header; the header's phis now
+	// come from the preheader instead of the block before
+	void LoopInvariantMotion::Rewrite()
+	{
+		std::vector<int> headerLoop(mCfg.GetNumBlocks(), -1);
+		for (int loop = 0; loop < mCfg.GetNumLoops(); loop++)
+		{
+			if (!mHoisted[loop].empty())
+			{
+				headerLoop[mCfg.GetLoop(loop).header] = loop;
+			}
+		}
+
+		std::vector<Ops> result;
+		result.reserve(mProgram.opsVector.size() + mCfg.GetNumLoops());
+		for (int b = 0; b < mCfg.GetNumBlocks(); b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			int loop = headerLoop[b];
+			if (loop >= 0)
+			{
+				Operand preheader = mProgram.NewLabel();
+				result.emplace_back(Ops(OpCode::Label, preheader));
+				for (int i : mHoisted[loop])
+				{
+					result.emplace_back(mProgram.opsVector[i]);
+				}
+
+				const Ops& entryFirst = mProgram.opsVector[mCfg.GetBlock(mEntry[loop]).first];
+				for (int i = block.first; i < block.end && entryFirst.op == OpCode::Label; i++)
+				{
+					const Ops& ops = mProgram.opsVector[i];
+					if (ops.op != OpCode::Phi)
+					{
+						continue;
+					}
+					for (PhiArg& arg : mProgram.phis[ops.params[1].value].args)
+					{
+						if (arg.pred == entryFirst.params[0].value)
+						{
+							arg.pred = preheader.value;
+						}
+					}
+				}
+			}
+
+			for (int i = block.first; i < block.end; i++)
+			{
+				if (!mMoved[i])
+				{
+					result.emplace_back(mProgram.opsVector[i]);
+				}
+			}
+		}
+		mProgram.opsVector.swap(result);
+	}
+}
+
+bool HoistLoopInvariants(CodeContext& program, const CFG& cfg, const Liveness& liveness)
+{
+	LoopInvariantMotion licm(program, cfg, liveness);
+	return licm.Run();
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "IR.h"
+
+class CFG;
+class Liveness;
+
+// Loop-invariant code motion
+// moves the instructions of a loop that compute the same value on every
+// iteration (constants, branch targets, arithmetic on values from outside
+// the loop, loads nothing in the loop can store to) into a preheader: a new
+// block placed right before the loop header that the loop is entered
+// through. An instruction leaves as many loops as it is invariant in.
+//
+// Only a VR's single def moves, so inc/dec'd VRs stay, and so does div,
+// which can trap. Loads only leave the loop from its header, which runs
+// whenever the loop is entered; loadi needs no storei to its slot in the
+// loop, load needs no store at all (the address isn't known). A loop gets a
+// preheader if it is entered from just the block before its header, falling
+// through; loops entered any other way are left alone.
+//
+// Each value moved out keeps a register busy for the whole loop, so a loop
+// only gives up as many instructions as it has registers to spare where the
+// most values are live; past that, spill code would cost more than it saves.
+// The registers the allocator keeps for spill code count as spare only when
+// nothing in the program looks like it will spill.
+//
+// Works on SSA form (header phis are updated) as well as outside it.
+
+// returns true if the program changed; cfg and liveness are the program's
+bool HoistLoopInvariants(CodeContext& program, const CFG& cfg, const Liveness& liveness);
@@ -0,0 +1,298 @@
+#include "Liveness.h"
+#include <algorithm>
+#include <utility>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+int Liveness::CountTrailingZeros(uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+void Liveness::Build(const CodeContext& program, const CFG& cfg)
+{
+	FindGlobals(program, cfg);
+	Solve(cfg);
+}
+
+// One pass to find the globals, a second one to fill Use/Kill now that
+// they have bit numbers. defBlock[vr] is 1 + the block vr was last written in.
+void Liveness::FindGlobals(const CodeContext& program, const CFG& cfg)
+{
+	mGlobals.clear();
+	mGlobalIndex.assign(program.lastVRegIndex, -1);
+	std::vector<int> defBlock(program.lastVRegIndex, 0);
+
+	int numBlocks = cfg.GetNumBlocks();
+	for (int b = 0; b < numBlocks; b++)
+	{
+		const BasicBlock& block = cfg.GetBlock(b);
+		for (int i = block.first; i < block.end; i++)
+		{
+			const Ops& ops = program.opsVector[i];
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				const Operand& param = ops.params[j];
+				if (param.IsVReg() && IsUse(ops, j) && defBlock[param.value] != b + 1
+					&& mGlobalIndex[param.value] < 0)
+				{
+					mGlobalIndex[param.value] = GetNumGlobals();
+					mGlobals.emplace_back(param.value);
+				}
+			}
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				if (ops.params[j].IsVReg() && IsDef(ops, j))
+				{
+					defBlock[ops.params[j].value] = b + 1;
+				}
+			}
+		}
+	}
+
+	// second pass: (global, block) of every upward-exposed use and def
+	std::vector<std::pair<int, int>> uses;
+	std::vector<std::pair<int, int>> defs;
+	std::fill(defBlock.begin(), defBlock.end(), 0);
+	for (int b = 0; b < numBlocks; b++)
+	{
+		const BasicBlock& block = cfg.GetBlock(b);
+		for (int i = block.first; i < block.end; i++)
+		{
+			const Ops& ops = program.opsVector[i];
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				const Operand& param = ops.params[j];
+				if (param.IsVReg() && IsUse(ops, j) && mGlobalIndex[param.value] >= 0
+					&& defBlock[param.value] != b + 1)
+				{
+					uses.emplace_back(mGlobalIndex[param.value], b);
+				}
+			}
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				const Operand& param = ops.params[j];
+				if (param.IsVReg() && IsDef(ops, j) && mGlobalIndex[param.value] >= 0
+					&& defBlock[param.value] != b + 1)
+				{
+					defs.emplace_back(mGlobalIndex[param.value], b);
+					defBlock[param.value] = b + 1;
+				}
+			}
+		}
+	}
+
+	mWords = (mGlobals.size() + 63) / 64;
+	mDense = static_cast<size_t>(numBlocks) * mWords <= kMaxDenseWords;
+
+	// the blocks of each global's uses and defs, grouped by global
+	auto group = [this](const std::vector<std::pair<int, int>>& pairs,
+		std::vector<int>& start, std::vector<int>& blocks) {
+		start.assign(mGlobals.size() + 1, 0);
+		for (auto& pair : pairs)
+		{
+			start[pair.first + 1]++;
+		}
+		for (size_t g = 0; g < mGlobals.size(); g++)
+		{
+			start[g + 1] += start[g];
+		}
+		blocks.resize(pairs.size());
+		std::vector<int> next(start.begin(), start.end() - 1);
+		for (auto& pair : pairs)
+		{
+			blocks[next[pair.first]++] = pair.second;
+		}
+	};
+	group(uses, mUseStart, mUseBlocks);
+	group(defs, mDefStart, mDefBlocks);
+	if (mDense)
+	{
+		MakeDense(numBlocks);
+		return;
+	}
+	mLiveInLists.assign(numBlocks, std::vector<int>());
+	mLiveOutLists.assign(numBlocks, std::vector<int>());
+}
+
+void Liveness::MakeDense(int numBlocks)
+{
+	mDense = true;
+	size_t size = static_cast<size_t>(numBlocks) * mWords;
+	mUse.assign(size, 0);
+	mKill.assign(size, 0);
+	mLiveIn.assign(size, 0);
+	mLiveOut.assign(size, 0);
+	for (int g = 0; g < GetNumGlobals(); g++)
+	{
+		uint64_t bit = uint64_t(1) << (g & 63);
+		for (int i = mUseStart[g]; i < mUseStart[g + 1]; i++)
+		{
+			Row(mUse, mUseBlocks[i])[g >> 6] |= bit;
+		}
+		for (int i = mDefStart[g]; i < mDefStart[g + 1]; i++)
+		{
+			Row(mKill, mDefBlocks[i])[g >> 6] |= bit;
+		}
+	}
+	mLiveInLists.clear();
+	mLiveOutLists.clear();
+}
+
+// One sweep in post-order first, so a block usually sees its successors'
+// final LiveIn. What flows along back edges is then finished with a worklist:
+// a block whose LiveIn changed puts the predecessors the sweep had already
+// passed back on it. The list is only started after the sweep, so all that
+// reaches a loop header goes down into the loop together (the outermost loop,
+// pushed last, is popped first) instead of one walk per header. The sets only
+// grow, so LiveOut can be or-ed into in place.
+void Liveness::Solve(const CFG& cfg)
+{
+	if (mWords == 0)
+	{
+		return;
+	}
+	if (!mDense)
+	{
+		if (SolveSparse(cfg))
+		{
+			return;
+		}
+		// the lists grew bigger than the bit vectors would be
+		MakeDense(cfg.GetNumBlocks());
+	}
+
+	// recomputes b's sets, true if its LiveIn changed
+	auto visit = [this, &cfg](int b) {
+		uint64_t* out = Row(mLiveOut, b);
+		for (int succ : cfg.GetBlock(b).succs)
+		{
+			const uint64_t* succIn = Row(mLiveIn, succ);
+			for (size_t w = 0; w < mWords; w++)
+			{
+				out[w] |= succIn[w];
+			}
+		}
+
+		const uint64_t* use = Row(mUse, b);
+		const uint64_t* kill = Row(mKill, b);
+		uint64_t* in = Row(mLiveIn, b);
+		uint64_t diff = 0;
+		for (size_t w = 0; w < mWords; w++)
+		{
+			uint64_t bits = use[w] | (out[w] & ~kill[w]);
+			diff |= bits ^ in[w];
+			in[w] = bits;
+		}
+		return diff != 0;
+	};
+
+	const std::vector<int>& order = cfg.GetReversePostOrder();
+	std::vector<bool> swept(cfg.GetNumBlocks(), false);
+	std::vector<bool> queued(cfg.GetNumBlocks(), false);
+	std::vector<int> work;
+	auto requeue = [&](int b) {
+		for (int pred : cfg.GetBlock(b).preds)
+		{
+			if (swept[pred] && !queued[pred])
+			{
+				queued[pred] = true;
+				work.emplace_back(pred);
+			}
+		}
+	};
+
+	for (size_t i = order.size(); i > 0; i--)
+	{
+		int b = order[i - 1];
+		swept[b] = true;
+		if (visit(b))
+		{
+			requeue(b);
+		}
+	}
+	while (!work.empty())
+	{
+		int b = work.back();
+		work.pop_back();
+		queued[b] = false;
+		if (visit(b))
+		{
+			requeue(b);
+		}
+	}
+}
+
+// Too many blocks and globals for a matrix: each global is followed up from
+// its uses through the predecessors until it reaches its definitions, so the
+// work and memory are the size of the live ranges. marks hold global + 1.
+// Live ranges that overlap a lot (loops nested deep, each with its own
+// globals) can make the lists bigger than the matrices after all; it gives
+// up and returns false once they take as much memory as one of them.
+bool Liveness::SolveSparse(const CFG& cfg)
+{
+	int numBlocks = cfg.GetNumBlocks();
+	// ints the lists may hold, as many bytes as one matrix: the lists
+	// can't get much smaller than the matrices once they are this far
+	size_t budget = 2 * static_cast<size_t>(numBlocks) * mWords;
+	size_t entries = 0;
+	std::vector<int> killed(numBlocks, 0);
+	std::vector<int> liveIn(numBlocks, 0);
+	std::vector<int> liveOut(numBlocks, 0);
+	std::vector<int> work;
+
+	for (int g = 0; g < GetNumGlobals(); g++)
+	{
+		int vreg = mGlobals[g];
+		for (int i = mDefStart[g]; i < mDefStart[g + 1]; i++)
+		{
+			killed[mDefBlocks[i]] = g + 1;
+		}
+		for (int i = mUseStart[g]; i < mUseStart[g + 1]; i++)
+		{
+			int b = mUseBlocks[i];
+			if (liveIn[b] != g + 1 && cfg.IsReachable(b))
+			{
+				liveIn[b] = g + 1;
+				mLiveInLists[b].emplace_back(vreg);
+				entries++;
+				work.emplace_back(b);
+			}
+		}
+
+		while (!work.empty())
+		{
+			int b = work.back();
+			work.pop_back();
+			for (int pred : cfg.GetBlock(b).preds)
+			{
+				if (liveOut[pred] == g + 1 || !cfg.IsReachable(pred))
+				{
+					continue;
+				}
+				liveOut[pred] = g + 1;
+				mLiveOutLists[pred].emplace_back(vreg);
+				entries++;
+				if (killed[pred] != g + 1 && liveIn[pred] != g + 1)
+				{
+					liveIn[pred] = g + 1;
+					mLiveInLists[pred].emplace_back(vreg);
+					entries++;
+					work.emplace_back(pred);
+				}
+			}
+		}
+		if (entries > budget)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include "CFG.h"
+
+// Liveness
+// which virtual registers are live on entry to and exit from each basic
+// block. Only VRs that are read in a block without being written there first
+// ("global" VRs) can be live across a block boundary, so the sets are bit
+// vectors over those alone; every other VR lives and dies inside one block.
+// The sets are solved with a worklist, LiveIn = Use | (LiveOut & ~Kill) and
+// LiveOut = union of the successors' LiveIn a word at a time, putting the
+// predecessors of a block back on the list whenever its LiveIn changes. When blocks x globals is too big for bit vectors
+// (SSA form gives every loop its own globals) each global is traced back from
+// its uses instead and the sets are kept as lists, unless the lists turn out
+// to be bigger still.
+class Liveness
+{
+public:
+	Liveness() = default;
+	Liveness(const CodeContext& program, const CFG& cfg) { Build(program, cfg); }
+
+	void Build(const CodeContext& program, const CFG& cfg);
+
+	int GetNumGlobals() const { return static_cast<int>(mGlobals.size()); }
+	// VR of global index i, and the global index of a VR (-1 if local)
+	int GetGlobalVReg(int i) const { return mGlobals[i]; }
+	int GetGlobalIndex(int vreg) const { return mGlobalIndex[vreg]; }
+
+	bool IsLiveIn(int block, int vreg) const { return Test(mLiveIn, mLiveInLists, block, vreg); }
+	bool IsLiveOut(int block, int vreg) const { return Test(mLiveOut, mLiveOutLists, block, vreg); }
+
+	// calls f(vreg) for every VR live on entry to/exit from block
+	template <typename F>
+	void ForEachLiveIn(int block, F f) const { ForEach(mLiveIn, mLiveInLists, block, f); }
+	template <typename F>
+	void ForEachLiveOut(int block, F f) const { ForEach(mLiveOut, mLiveOutLists, block, f); }
+
+private:
+	// largest bit matrix (blocks x words) used for one set, 32 MiB
+	static const size_t kMaxDenseWords = 4 * 1024 * 1024;
+
+	// the words of one block's set
+	uint64_t* Row(std::vector<uint64_t>& sets, int block) { return sets.data() + static_cast<size_t>(block) * mWords; }
+	const uint64_t* Row(const std::vector<uint64_t>& sets, int block) const { return sets.data() + static_cast<size_t>(block) * mWords; }
+
+	bool Test(const std::vector<uint64_t>& sets, const std::vector<std::vector<int>>& lists,
+		int block, int vreg) const
+	{
+		int i = mGlobalIndex[vreg];
+		if (i < 0 || mWords == 0)
+		{
+			return false;
+		}
+		if (!mDense)
+		{
+			const std::vector<int>& list = lists[block];
+			return std::find(list.begin(), list.end(), vreg) != list.end();
+		}
+		return (Row(sets, block)[i >> 6] >> (i & 63)) & 1;
+	}
+
+	template <typename F>
+	void ForEach(const std::vector<uint64_t>& sets, const std::vector<std::vector<int>>& lists,
+		int block, F f) const
+	{
+		if (mWords == 0)
+		{
+			return;
+		}
+		if (!mDense)
+		{
+			for (int vreg : lists[block])
+			{
+				f(vreg);
+			}
+			return;
+		}
+		const uint64_t* row = Row(sets, block);
+		for (size_t w = 0; w < mWords; w++)
+		{
+			for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1)
+			{
+				f(mGlobals[w * 64 + CountTrailingZeros(bits)]);
+			}
+		}
+	}
+
+	static int CountTrailingZeros(uint64_t bits);
+
+	void FindGlobals(const CodeContext& program, const CFG& cfg);
+	void Solve(const CFG& cfg);
+	bool SolveSparse(const CFG& cfg);
+	// switches to the bit vectors, filled from the grouped uses and defs
+	void MakeDense(int numBlocks);
+
+	std::vector<int> mGlobals;
+	std::vector<int> mGlobalIndex;
+
+	// one row of mWords words per block
+	size_t mWords = 0;
+	// globals read before any write in the block, and written in it
+	std::vector<uint64_t> mUse;
+	std::vector<uint64_t> mKill;
+	std::vector<uint64_t> mLiveIn;
+	std::vector<uint64_t> mLiveOut;
+
+	// false while the sets are the lists below
+	bool mDense = true;
+	// blocks of the uses/defs of global g are
+	// mUseBlocks[mUseStart[g]..mUseStart[g + 1]), same for defs
+	std::vector<int> mUseStart;
+	std::vector<int> mUseBlocks;
+	std::vector<int> mDefStart;
+	std::vector<int> mDefBlocks;
+	std::vector<std::vector<int>> mLiveInLists;
+	std::vector<std::vector<int>> mLiveOutLists;
+};
@@ -1,11 +1,82 @@
 #include "Node.h"
+#include <limits>
 
-void NBlock::AddStatement(NStatement* statement)
+Ast::Ast(Arena& arena)
+	:mNumerics(ArenaAllocator<int>(arena))
+	,mLists(ArenaAllocator<ListNode>(arena))
+	,mListItems(ArenaAllocator<NodeRef>(arena))
+	,mDecls(ArenaAllocator<DeclNode>(arena))
+	,mNames(ArenaAllocator<NameNode>(arena))
+	,mBinaries(ArenaAllocator<BinaryNode>(arena))
+	,mBranches(ArenaAllocator<BranchNode>(arena))
+	,mUnaries(ArenaAllocator<UnaryNode>(arena))
+	,mPending(ArenaAllocator<NodeRef>(arena))
 {
-	mStatements.emplace_back(statement);
 }
 
-void NData::AddDecl(NDecl* decl)
+NodeRef Ast::AddNumeric(int value)
 {
-	mDecls.emplace_back(decl);
+	return Push(mNumerics, NodeKind::Numeric, value);
+}
+
+NodeRef Ast::AddDecl(NodeKind kind, int symbol, NodeRef size)
+{
+	return Push(mDecls, kind, DeclNode{ symbol, size });
+}
+
+NodeRef Ast::AddName(NodeKind kind, int symbol, NodeRef subscript, NodeRef rhs)
+{
+	return Push(mNames, kind, NameNode{ symbol, -1, subscript, rhs });
+}
+
+NodeRef Ast::AddBinary(NodeKind kind, NodeRef lhs, int op, NodeRef rhs)
+{
+	return Push(mBinaries, kind, BinaryNode{ lhs, rhs, op });
+}
+
+NodeRef Ast::AddBranch(NodeKind kind, NodeRef comp, NodeRef block, NodeRef elseBlock)
+{
+	return Push(mBranches, kind, BranchNode{ comp, block, elseBlock });
+}
+
+NodeRef Ast::AddUnary(NodeKind kind, NodeRef child)
+{
+	return Push(mUnaries, kind, UnaryNode{ child });
+}
+
+NodeRef Ast::AddLeaf(NodeKind kind)
+{
+	return NodeRef::Make(kind, 0);
+}
+
+NodeRef Ast::EndList(NodeKind kind, uint32_t start)
+{
+	// lists nested inside this one were closed before it got their parent,
+	// so everything above start belongs to it
+	ListNode list = { static_cast<uint32_t>(mListItems.size()),
+		static_cast<uint32_t>(mPending.size()) - start };
+	mListItems.insert(mListItems.end(), mPending.begin() + start, mPending.end());
+	mPending.resize(start);
+	return Push(mLists, kind, list);
+}
+
+void Ast::SetProgram(NodeRef data, NodeRef main)
+{
+	mData = data;
+	mMain = main;
+}
+
+bool ParseNumeric(TokenText value, int& result)
+{
+	result = 0;
+	for (int i = 0; i < value.length; i++)
+	{
+		int digit = value.text[i] - '0';
+		if (result > (std::numeric_limits<int>::max() - digit) / 10)
+		{
+			return false;
+		}
+		result = result * 10 + digit;
+	}
+	return true;
 }
@@ -1,395 +1,199 @@
 #pragma once
-#include <vector>
-#include <string>
-#include <ostream>
-#include <map>
-
-// Operations Struct
-// This will be used to define the various instructions
-struct Ops
-{
-	std::string op;
-	std::vector<std::string> params;
-
-	Ops(std::string str) {
-		op = str;
+#include <cstdint>
+#include "IR.h"
+#include "Arena.h"
+#include "SymbolTable.h"
+
+struct ResolveContext;
+
+// NodeKind
+// what a node is; decides which array its record lives in and how the
+// traversals (OutputAST, Resolve, CodeGen) handle it
+enum class NodeKind : uint8_t
+{
+	Data,
+	Block,
+	Numeric,
+	VarDecl,
+	ArrayDecl,
+	NumericExpr,
+	VarExpr,
+	BinaryExpr,
+	ArrayExpr,
+	AssignVarStmt,
+	AssignArrayStmt,
+	IncStmt,
+	DecStmt,
+	Comparison,
+	IfStmt,
+	WhileStmt,
+	PenUpStmt,
+	PenDownStmt,
+	SetPosStmt,
+	SetColorStmt,
+	FwdStmt,
+	BackStmt,
+	RotStmt,
+};
+
+// NodeRef
+// 32-bit handle to a node: the kind in the top 5 bits and the index into
+// the array for that kind's shape in the low 27
+struct NodeRef
+{
+	static const int kIndexBits = 27;
+	static const uint32_t kIndexMask = (1u << kIndexBits) - 1;
+	static const uint32_t kNone = 0xffffffff;
+
+	uint32_t bits;
+
+	static NodeRef Make(NodeKind kind, uint32_t index)
+	{
+		return NodeRef{ (static_cast<uint32_t>(kind) << kIndexBits) | index };
 	}
-};
-
-// CodeContext
-// contains the data needed to store instructions and
-// track locations of variables/arrays on stack
-struct CodeContext
-{
-	//  vector to store generated instructions
-	std::vector<Ops> opsVector;
-
-	// count of the last virtual register index used
-	int lastVRegIndex = 0;
-
-	// count of the last stack index used
-	int lastStackIndex = 0;
-
-	// map to track which variables/arrays correspond to which indices on the stack
-	std::map<std::string, int> varTracker;
-	
-
-
-	CodeContext() = default;
-
-};
-
-// Node class definition
-class Node
-{
-public:
-	virtual void OutputAST(std::ostream& stream, int depth) const = 0;
-	virtual void CodeGen(CodeContext& context) = 0;
-protected:
-	void OutputMargin(std::ostream& stream, int depth) const;
-};
-
-class NDecl : public Node
-{
-};
-
-// Data definition
-class NData : public Node
-{
-public:
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-	void AddDecl(NDecl* decl);
-private:
-	std::vector<NDecl*> mDecls;
-};
-
-class NStatement : public Node
-{
-};
+	static NodeRef None() { return NodeRef{ kNone }; }
 
-// Block Definition
-class NBlock : public Node
-{
-public:
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-	void AddStatement(NStatement* statement);
-private:
-	std::vector<NStatement*> mStatements;
+	NodeKind GetKind() const { return static_cast<NodeKind>(bits >> kIndexBits); }
+	uint32_t GetIndex() const { return bits & kIndexMask; }
+	bool IsNone() const { return bits == kNone; }
 };
 
-// Program Definition
-class NProgram : public Node
-{
-public:
-	NProgram(NData* data, NBlock* main)
-		:mData(data)
-		,mMain(main)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NData* mData;
-	NBlock* mMain;
-};
+// Node records, one array per shape. Kinds that look alike share a shape
+// (the kind in the NodeRef tells them apart), and kinds without any fields
+// (PenUpStmt, PenDownStmt) have no record at all.
 
-// Numeric Definition
-class NNumeric : public Node
+// Data, Block: a run of children in Ast's list array
+struct ListNode
 {
-public:
-	NNumeric(std::string& value)
-		:mValue(std::stoi(value))
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-
-	int GetValue() const { return mValue; }
-private:
-	int mValue;
+	uint32_t first;
+	uint32_t count;
 };
 
-// Variable Declaration Definition
-class NVarDecl : public NDecl
+// VarDecl, ArrayDecl (size is the Numeric for arrays, None for vars)
+struct DeclNode
 {
-public:
-	NVarDecl(std::string& name)
-		:mName(name)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	std::string mName;
+	int symbol;
+	NodeRef size;
 };
 
-// Array Declaration Definition
-class NArrayDecl : public NDecl
+// VarExpr, ArrayExpr, AssignVarStmt, AssignArrayStmt, IncStmt, DecStmt:
+// everything that uses a name, with the children it has (or None)
+struct NameNode
 {
-public:
-	NArrayDecl(std::string& name, NNumeric* size)
-		:mName(name)
-		,mSize(size)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	std::string mName;
-	NNumeric* mSize;
+	int symbol;
+	// stack index of the variable (first element for arrays), set by Resolve
+	int slot;
+	NodeRef subscript;
+	NodeRef rhs;
 };
 
-// Expression Definition
-class NExpr : public Node
+// BinaryExpr, Comparison (op is the operator's token), SetPosStmt (x and y)
+struct BinaryNode
 {
-public:
-	const std::string& GetResultRegister() const { return mResultRegister; }
-protected:
-	std::string mResultRegister;
-};
-
-// Numeric Exprression Definition
-class NNumericExpr : public NExpr
-{
-public:
-	NNumericExpr(NNumeric* num)
-		:mNumeric(num)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NNumeric* mNumeric;
+	NodeRef lhs;
+	NodeRef rhs;
+	int op;
 };
 
-// Variable Expression Definition
-class NVarExpr : public NExpr
+// IfStmt, WhileStmt (elseBlock is None for while and for if without else)
+struct BranchNode
 {
-public:
-	NVarExpr(std::string& name)
-		:mName(name)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	std::string mName;
-};
-
-// Binary Expression Definition
-class NBinaryExpr : public NExpr
-{
-public:
-	NBinaryExpr(NExpr* lhs, int type, NExpr* rhs)
-		:mLhs(lhs)
-		,mRhs(rhs)
-		,mType(type)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NExpr* mLhs;
-	NExpr* mRhs;
-	int mType;
+	NodeRef comp;
+	NodeRef block;
+	NodeRef elseBlock;
 };
 
-// Array Expression Definition Definition
-class NArrayExpr : public NExpr
+// NumericExpr, SetColorStmt, FwdStmt, BackStmt, RotStmt
+struct UnaryNode
 {
-public:
-	NArrayExpr(std::string& name, NExpr* subscript)
-		:mName(name)
-		,mSubscript(subscript)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	std::string mName;
-	NExpr* mSubscript;
+	NodeRef child;
 };
 
-// Variable Assignment Statement Definition
-class NAssignVarStmt : public NStatement
+// Ast
+// the whole tree of one compilation, stored flat in the compilation's Arena.
+// Children are NodeRefs rather than pointers, and the traversals dispatch on
+// the kind with a switch. The parser adds children before their parents;
+// Data and Block children are collected on a pending stack (BeginList,
+// AddToList) and moved into one contiguous run when the list is closed.
+class Ast
 {
 public:
-	NAssignVarStmt(std::string& name, NExpr* rhs)
-		:mName(name)
-		,mRhs(rhs)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	std::string mName;
-	NExpr* mRhs;
-};
+	explicit Ast(Arena& arena);
 
-// Array Assignment Statement Definition
-class NAssignArrayStmt : public NStatement
-{
-public:
-	NAssignArrayStmt(std::string& name, NExpr* subscript, NExpr* rhs)
-		:mName(name)
-		,mSubscript(subscript)
-		,mRhs(rhs)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	std::string mName;
-	NExpr* mSubscript;
-	NExpr* mRhs;
-};
+	NodeRef AddNumeric(int value);
+	NodeRef AddDecl(NodeKind kind, int symbol, NodeRef size);
+	NodeRef AddName(NodeKind kind, int symbol, NodeRef subscript, NodeRef rhs);
+	NodeRef AddBinary(NodeKind kind, NodeRef lhs, int op, NodeRef rhs);
+	NodeRef AddBranch(NodeKind kind, NodeRef comp, NodeRef block, NodeRef elseBlock);
+	NodeRef AddUnary(NodeKind kind, NodeRef child);
+	NodeRef AddLeaf(NodeKind kind);
 
-// Increment Definition ++ 
-class NIncStmt : public NStatement
-{
-public:
-	NIncStmt(std::string& name)
-		:mName(name)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	std::string mName;
-};
+	// starts a list at the top of the pending stack, returns where it starts
+	uint32_t BeginList() const { return static_cast<uint32_t>(mPending.size()); }
+	void AddToList(NodeRef node) { mPending.emplace_back(node); }
+	// pops the list that started at start and makes a Data/Block node of it
+	NodeRef EndList(NodeKind kind, uint32_t start);
 
-// Decrement Definition --
-class NDecStmt : public NStatement
-{
-public:
-	NDecStmt(std::string& name)
-		:mName(name)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	std::string mName;
-};
+	// the root: program -> data, main
+	void SetProgram(NodeRef data, NodeRef main);
+	bool HasProgram() const { return !mMain.IsNone(); }
+	NodeRef GetData() const { return mData; }
+	NodeRef GetMain() const { return mMain; }
 
-// Comparison Definition
-class NComparison : public Node
-{
-public:
-	NComparison(NExpr* lhs, int type, NExpr* rhs)
-		:mLhs(lhs)
-		,mRhs(rhs)
-		,mType(type)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NExpr* mLhs;
-	NExpr* mRhs;
-	int mType;
-};
+	int GetNumeric(NodeRef node) const { return mNumerics[node.GetIndex()]; }
+	const ListNode& GetList(NodeRef node) const { return mLists[node.GetIndex()]; }
+	NodeRef GetListItem(const ListNode& list, uint32_t i) const { return mListItems[list.first + i]; }
+	const DeclNode& GetDecl(NodeRef node) const { return mDecls[node.GetIndex()]; }
+	const NameNode& GetName(NodeRef node) const { return mNames[node.GetIndex()]; }
+	NameNode& GetName(NodeRef node) { return mNames[node.GetIndex()]; }
+	const BinaryNode& GetBinary(NodeRef node) const { return mBinaries[node.GetIndex()]; }
+	const BranchNode& GetBranch(NodeRef node) const { return mBranches[node.GetIndex()]; }
+	const UnaryNode& GetUnary(NodeRef node) const { return mUnaries[node.GetIndex()]; }
 
-// If Statement Definition
-class NIfStmt : public NStatement
-{
-public:
-	NIfStmt(NComparison* comp, NBlock* ifBlock, NBlock* elseBlock)
-		:mComp(comp)
-		,mIfBlock(ifBlock)
-		,mElseBlock(elseBlock)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NComparison* mComp;
-	NBlock* mIfBlock;
-	NBlock* mElseBlock;
-};
+	// true if a shape got more records than a NodeRef can index; the ones
+	// past that were dropped, so the tree is incomplete
+	bool IsTooLarge() const { return mTooLarge; }
 
-// While Statement Definition
-class NWhileStmt : public NStatement
-{
-public:
-	NWhileStmt(NComparison* comp, NBlock* block)
-		:mComp(comp)
-		,mBlock(block)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
 private:
-	NComparison* mComp;
-	NBlock* mBlock;
-};
+	template <typename T>
+	NodeRef Push(ArenaVector<T>& array, NodeKind kind, const T& record)
+	{
+		// the index must not run into the kind bits
+		if (array.size() > NodeRef::kIndexMask)
+		{
+			mTooLarge = true;
+			return NodeRef::None();
+		}
+		array.emplace_back(record);
+		return NodeRef::Make(kind, static_cast<uint32_t>(array.size() - 1));
+	}
 
-// Pen Up Statement Definition
-class NPenUpStmt : public NStatement
-{
-public:
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-};
+	ArenaVector<int> mNumerics;
+	ArenaVector<ListNode> mLists;
+	ArenaVector<NodeRef> mListItems;
+	ArenaVector<DeclNode> mDecls;
+	ArenaVector<NameNode> mNames;
+	ArenaVector<BinaryNode> mBinaries;
+	ArenaVector<BranchNode> mBranches;
+	ArenaVector<UnaryNode> mUnaries;
 
-// Pen Down Statement Definition
-class NPenDownStmt : public NStatement
-{
-public:
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-};
+	// children of the Data/Block lists still being parsed
+	ArenaVector<NodeRef> mPending;
 
-// Set Position Statement Definition
-class NSetPosStmt : public NStatement
-{
-public:
-	NSetPosStmt(NExpr* x, NExpr* y)
-		:mXExpr(x)
-		,mYExpr(y)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NExpr* mXExpr;
-	NExpr* mYExpr;
+	NodeRef mData = NodeRef::None();
+	NodeRef mMain = NodeRef::None();
+	bool mTooLarge = false;
 };
 
-// Set Color Statement Definition
-class NSetColorStmt : public NStatement
-{
-public:
-	NSetColorStmt(NExpr* color)
-		:mColor(color)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NExpr* mColor;
-};
+// value of a numeric token, the scanner only matches digits for these;
+// false if it doesn't fit in an int
+bool ParseNumeric(TokenText value, int& result);
 
-// Move Pen Forward Statement Definition
-class NFwdStmt : public NStatement
-{
-public:
-	NFwdStmt(NExpr* param)
-		:mParam(param)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NExpr* mParam;
-};
+// writes the tree in the ast.txt format
+void OutputAST(TextWriter& out, const Ast& ast, const SymbolTable& symbols);
 
-// Move Pen Back Statement Definition
-class NBackStmt : public NStatement
-{
-public:
-	NBackStmt(NExpr* param)
-		:mParam(param)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NExpr* mParam;
-};
+// binds every name in the tree to its stack slot
+void Resolve(Ast& ast, ResolveContext& context);
 
-// Rotate Pen Statement Definition
-class NRotStmt : public NStatement
-{
-public:
-	NRotStmt(NExpr* param)
-		:mParam(param)
-	{ }
-	void OutputAST(std::ostream& stream, int depth) const override;
-	void CodeGen(CodeContext& context) override;
-private:
-	NExpr* mParam;
-};
+// generates the program with virtual registers
+void CodeGen(const Ast& ast, CodeContext& context);
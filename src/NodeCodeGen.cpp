@@ -1,461 +1,405 @@
 #include "Node.h"
 #include "parser.hpp"
-#include <algorithm>
+#include <vector>
 
-void NBlock::CodeGen(CodeContext& context)
-{
-	for (auto& i : mStatements) {
-		i->CodeGen(context);
-	}
-}
+// Code generation walks the tree with an explicit stack instead of recursion,
+// so deeply nested blocks or very long expressions are limited by heap memory
+// rather than the thread's stack. A node that has to do something after its
+// children (emit its instruction, patch a jump) is pushed back with the next
+// stage before them. Expressions leave their result register on a value stack.
 
-void NData::CodeGen(CodeContext& context)
+namespace
 {
-	for (auto& i : mDecls) {
-		i->CodeGen(context);
+	struct CodeGenTask
+	{
+		NodeRef node;
+		int stage;
+		// label ids a statement needs in a later stage
+		int first;
+		int second;
+	};
+
+	class CodeGenWalker
+	{
+	public:
+		CodeGenWalker(const Ast& ast, CodeContext& context)
+			:mAst(ast)
+			,mContext(context)
+		{ }
+
+		void Run(NodeRef root);
+
+	private:
+		void Push(NodeRef node, int stage = 0, int first = 0, int second = 0)
+		{
+			mTasks.emplace_back(CodeGenTask{ node, stage, first, second });
+		}
+
+		// a Data/Block's children, pushed so the first one runs first
+		void PushList(NodeRef node);
+
+		Operand PopValue()
+		{
+			Operand value = mValues.back();
+			mValues.pop_back();
+			return value;
+		}
+
+		void Visit(const CodeGenTask& task);
+
+		// loads the variable, applies inc/dec to it and stores it back
+		void GenStep(NodeRef node, OpCode op);
+
+		const Ast& mAst;
+		CodeContext& mContext;
+		std::vector<CodeGenTask> mTasks;
+		std::vector<Operand> mValues;
+	};
+
+	void CodeGenWalker::Run(NodeRef root)
+	{
+		Push(root);
+		while (!mTasks.empty())
+		{
+			CodeGenTask task = mTasks.back();
+			mTasks.pop_back();
+			Visit(task);
+		}
 	}
-}
-
-void NProgram::CodeGen(CodeContext& context)
-{
-	mData->CodeGen(context);
-	mMain->CodeGen(context);
-	// at this point, the final stage is to exit the program
-	Ops pro("exit");
-	context.opsVector.emplace_back(pro);
-}
-
-void NNumeric::CodeGen(CodeContext& context)
-{
-}
 
-void NVarDecl::CodeGen(CodeContext& context)
-{
-	// add push operation for new variable
-	Ops var("push");
-	var.params.emplace_back("r0");
-	context.opsVector.emplace_back(var);
-	
-	// place the variable into the map and increase the stack counter
-	context.varTracker[mName] = context.lastStackIndex;
-	context.lastStackIndex++;
-	
-}
-
-void NArrayDecl::CodeGen(CodeContext& context)
-{
-	// add push operation for every element in array
-	for (int i = 0; i < mSize->GetValue(); i++) {
-		Ops var("push");
-		var.params.emplace_back("r0");
-		context.opsVector.emplace_back(var);
-		context.lastStackIndex++;
+	void CodeGenWalker::PushList(NodeRef node)
+	{
+		const ListNode& list = mAst.GetList(node);
+		for (uint32_t i = list.count; i > 0; i--) {
+			Push(mAst.GetListItem(list, i - 1));
+		}
 	}
-	// add to map of variables
-	context.varTracker[mName] = context.lastStackIndex - mSize->GetValue();
-	
-}
 
-void NNumericExpr::CodeGen(CodeContext& context)
-{
-	// assigns the current register to the numeric
-	std::string val = std::to_string(mNumeric->GetValue());
-	mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	Ops num("movi");
-	num.params.emplace_back(mResultRegister);
-	num.params.emplace_back(val);
-	context.opsVector.emplace_back(num);
-}
+	void CodeGenWalker::GenStep(NodeRef node, OpCode op)
+	{
+		// retreive data from stack
+		Operand resultReg = mContext.NewVReg();
+		Operand slot = Operand::Stack(mAst.GetName(node).slot);
+		mContext.Emit(Ops(OpCode::Loadi, resultReg, slot));
 
-void NVarExpr::CodeGen(CodeContext& context)
-{
-	// loads the necessary value from the stack
-	Ops var("loadi");
-	mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	var.params.emplace_back(mResultRegister);
-	var.params.emplace_back(std::to_string(context.varTracker.find(mName)->second));
-	context.opsVector.emplace_back(var);
-}
+		// increment/decrement
+		mContext.Emit(Ops(op, resultReg));
 
-void NBinaryExpr::CodeGen(CodeContext& context)
-{
-	mLhs->CodeGen(context);
-	mRhs->CodeGen(context);
-	// addition
-	if (mType == TADD) {
-		Ops bin("add");
-		mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-		context.lastVRegIndex++;
-		bin.params.emplace_back(mResultRegister);
-		bin.params.emplace_back(mLhs->GetResultRegister());
-		bin.params.emplace_back(mRhs->GetResultRegister());
-		context.opsVector.emplace_back(bin);
-	}
-	// multiplication
-	if (mType == TMUL) {
-		Ops bin("mul");
-		mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-		context.lastVRegIndex++;
-		bin.params.emplace_back(mResultRegister);
-		bin.params.emplace_back(mLhs->GetResultRegister());
-		bin.params.emplace_back(mRhs->GetResultRegister());
-		context.opsVector.emplace_back(bin);
-	}
-	// subtraction
-	if (mType == TSUB) {
-		Ops bin("sub");
-		mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-		context.lastVRegIndex++;
-		bin.params.emplace_back(mResultRegister);
-		bin.params.emplace_back(mLhs->GetResultRegister());
-		bin.params.emplace_back(mRhs->GetResultRegister());
-		context.opsVector.emplace_back(bin);
+		// store new value
+		mContext.Emit(Ops(OpCode::Storei, slot, resultReg));
 	}
-	// division
-	if (mType == TDIV) {
-		Ops bin("div");
-		mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-		context.lastVRegIndex++;
-		bin.params.emplace_back(mResultRegister);
-		bin.params.emplace_back(mLhs->GetResultRegister());
-		bin.params.emplace_back(mRhs->GetResultRegister());
-		context.opsVector.emplace_back(bin);
-	}
-
-
-}
-
-void NArrayExpr::CodeGen(CodeContext& context)
-{
-	// grab the value from an index of the array
-	mSubscript->CodeGen(context);
-	mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-	std::string mov = mResultRegister;
-	context.lastVRegIndex++;
-	int base = context.varTracker.find(mName)->second;
-	Ops arrEx("movi");
-	arrEx.params.emplace_back(mov);
-	arrEx.params.emplace_back(std::to_string(base));
-	context.opsVector.emplace_back(arrEx);
-
-	//calculate offset
-	std::string tempo = mSubscript->GetResultRegister();
-	std::string s = tempo.substr(1);
-	int a = std::stoi(s);
-	int address = a + base;
-
-	// add values
-	Ops add("add");
-	mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-	std::string addReg = mResultRegister;
-	context.lastVRegIndex++;
-	add.params.emplace_back(mResultRegister);
-	std::string addressstr = "%" + std::to_string(address);
-	add.params.emplace_back(mov);
-	add.params.emplace_back(tempo);
-	context.opsVector.emplace_back(add);
-
-	// load a value from the stack
-	Ops load("load");
-	mResultRegister = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	load.params.emplace_back(mResultRegister);
-	load.params.emplace_back(addReg);
-	context.opsVector.emplace_back(load);
-	
-}
-
-void NAssignVarStmt::CodeGen(CodeContext& context)
-{
-	mRhs->CodeGen(context);
-
-	// store a register of data on the stack
-	Ops varSt("storei");
-	varSt.params.emplace_back(std::to_string(context.varTracker.find(mName)->second));
-	varSt.params.emplace_back(mRhs->GetResultRegister());
-	context.opsVector.emplace_back(varSt);
-
 
-}
-
-void NAssignArrayStmt::CodeGen(CodeContext& context)
-{
-	mRhs->CodeGen(context);
-	mSubscript->CodeGen(context);
-	// grab the value from an index of the array
-	std::string mov = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	std::string base1 = std::to_string(context.varTracker.find(mName)->second);
-
-	// set a value to a register
-	Ops first("movi");
-	first.params.emplace_back(mov);
-	first.params.emplace_back(base1);
-	context.opsVector.emplace_back(first);
-
-
-	// calculate base/offset
-	int base = context.varTracker.find(mName)->second;
-	std::string tempo = mSubscript->GetResultRegister();
-	std::string s = tempo.substr(1);
-	int a = std::stoi(s);
-	int address = a + base;
-
-	std::string add = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	std::string addressstr = "%" + std::to_string(address);
-
-	// add two register values together
-	Ops second("add");
-	second.params.emplace_back(add);
-	second.params.emplace_back(mov);
-	second.params.emplace_back(tempo);
-	context.opsVector.emplace_back(second);
-
-	// store the value of a second register in the space of a first register
-	Ops arr("store");
-	arr.params.emplace_back(add);
-	arr.params.emplace_back(mRhs->GetResultRegister());
-	context.opsVector.emplace_back(arr);
-}
-
-void NIncStmt::CodeGen(CodeContext& context)
-{
-	// retreive data from stack
-	Ops load("loadi");
-	std::string resultReg = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	load.params.emplace_back(resultReg);
-	load.params.emplace_back(std::to_string(context.varTracker.find(mName)->second));
-	context.opsVector.emplace_back(load);
-
-	// increment
-	Ops inc("inc");
-	//context.varTracker[mName] = val;
-	inc.params.emplace_back(resultReg);
-	context.opsVector.emplace_back(inc);
-
-	// store new value
-	Ops store("storei");
-	store.params.emplace_back(std::to_string(context.varTracker.find(mName)->second));
-	store.params.emplace_back(resultReg);
-	context.opsVector.emplace_back(store);
-
-
-}
-
-void NDecStmt::CodeGen(CodeContext& context)
-{
-	// retreive data from stack
-	Ops load("loadi");
-	std::string resultReg = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	load.params.emplace_back(resultReg);
-	load.params.emplace_back(std::to_string(context.varTracker.find(mName)->second));
-	context.opsVector.emplace_back(load);
-
-	// decrement
-	Ops dec("dec");
-	//context.varTracker[mName] = val;
-	dec.params.emplace_back(resultReg);
-	context.opsVector.emplace_back(dec);
-
-	// store new value
-	Ops store("storei");
-	store.params.emplace_back(std::to_string(context.varTracker.find(mName)->second));
-	store.params.emplace_back(resultReg);
-	context.opsVector.emplace_back(store);
-}
-
-void NComparison::CodeGen(CodeContext& context)
-{
-	mLhs->CodeGen(context);
-	mRhs->CodeGen(context);
-	
-	// equals
-	if (mType == TISEQUAL) {
-		Ops cmpeq("cmpeq");
-		std::string l = mLhs->GetResultRegister();
-		std::string r = mRhs->GetResultRegister();
-		cmpeq.params.emplace_back(l);
-		cmpeq.params.emplace_back(r);
-		context.opsVector.emplace_back(cmpeq);
-	}
-	// less
-	if (mType == TLESS) {
-		Ops cmplt("cmplt");
-		std::string l = mLhs->GetResultRegister();
-		std::string r = mRhs->GetResultRegister();
-		cmplt.params.emplace_back(l);
-		cmplt.params.emplace_back(r);
-		context.opsVector.emplace_back(cmplt);
-	}
-
-
-}
-
-void NIfStmt::CodeGen(CodeContext& context)
-{
-
-	mComp->CodeGen(context);
-
-	// set data to register
-	Ops movi("movi");
-	std::string first = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	std::string qu = "??";
-	movi.params.emplace_back(first);
-	movi.params.emplace_back(qu);
-	context.opsVector.emplace_back(movi);
-	int temp = context.opsVector.size();
-
-	// if false, sets the pc to the reg
-	Ops jnt("jnt");
-	jnt.params.emplace_back(first);
-	context.opsVector.emplace_back(jnt);
-
-
-	// if block
-	mIfBlock->CodeGen(context);
-
-
-	// no else block
-	if (mElseBlock == nullptr) {
-		qu = std::to_string(context.opsVector.size());
-		context.opsVector[temp - 1].params[1] = qu;
+	void CodeGenWalker::Visit(const CodeGenTask& task)
+	{
+		NodeRef node = task.node;
+		switch (node.GetKind())
+		{
+		case NodeKind::Data:
+		case NodeKind::Block:
+			PushList(node);
+			break;
+		case NodeKind::VarDecl:
+			// add push operation for new variable, its slot was assigned by Resolve
+			mContext.Emit(Ops(OpCode::Push, Operand::PhysReg(0)));
+			mContext.lastStackIndex++;
+			mContext.arraySlots.emplace_back(false);
+			break;
+		case NodeKind::ArrayDecl:
+		{
+			// add push operation for every element in array
+			int size = mAst.GetNumeric(mAst.GetDecl(node).size);
+			for (int i = 0; i < size; i++) {
+				mContext.Emit(Ops(OpCode::Push, Operand::PhysReg(0)));
+				mContext.lastStackIndex++;
+				mContext.arraySlots.emplace_back(true);
+			}
+			break;
+		}
+		case NodeKind::NumericExpr:
+		{
+			// assigns the current register to the numeric
+			Operand result = mContext.NewVReg();
+			int value = mAst.GetNumeric(mAst.GetUnary(node).child);
+			mContext.Emit(Ops(OpCode::Movi, result, Operand::Imm(value)));
+			mValues.emplace_back(result);
+			break;
+		}
+		case NodeKind::VarExpr:
+		{
+			// loads the necessary value from the stack
+			Operand result = mContext.NewVReg();
+			Operand slot = Operand::Stack(mAst.GetName(node).slot);
+			mContext.Emit(Ops(OpCode::Loadi, result, slot));
+			mValues.emplace_back(result);
+			break;
+		}
+		case NodeKind::BinaryExpr:
+		case NodeKind::Comparison:
+		case NodeKind::SetPosStmt:
+		{
+			const BinaryNode& binary = mAst.GetBinary(node);
+			if (task.stage == 0) {
+				// lhs, then rhs, then this
+				Push(node, 1);
+				Push(binary.rhs);
+				Push(binary.lhs);
+				break;
+			}
+
+			Operand rhs = PopValue();
+			Operand lhs = PopValue();
+			if (node.GetKind() == NodeKind::Comparison) {
+				// equals
+				if (binary.op == TISEQUAL) {
+					mContext.Emit(Ops(OpCode::Cmpeq, lhs, rhs));
+				}
+				// less
+				if (binary.op == TLESS) {
+					mContext.Emit(Ops(OpCode::Cmplt, lhs, rhs));
+				}
+				break;
+			}
+			if (node.GetKind() == NodeKind::SetPosStmt) {
+				mContext.Emit(Ops(OpCode::Mov, Operand::Special(SpecialReg::Tx), lhs));
+				mContext.Emit(Ops(OpCode::Mov, Operand::Special(SpecialReg::Ty), rhs));
+				break;
+			}
+
+			OpCode op = OpCode::Add;
+			switch (binary.op)
+			{
+			// addition
+			case TADD:
+				op = OpCode::Add;
+				break;
+			// multiplication
+			case TMUL:
+				op = OpCode::Mul;
+				break;
+			// subtraction
+			case TSUB:
+				op = OpCode::Sub;
+				break;
+			// division
+			case TDIV:
+				op = OpCode::Div;
+				break;
+			default:
+				break;
+			}
+
+			Operand result = mContext.NewVReg();
+			mContext.Emit(Ops(op, result, lhs, rhs));
+			mValues.emplace_back(result);
+			break;
+		}
+		case NodeKind::ArrayExpr:
+		{
+			const NameNode& name = mAst.GetName(node);
+			if (task.stage == 0) {
+				Push(node, 1);
+				Push(name.subscript);
+				break;
+			}
+
+			// grab the value from an index of the array
+			Operand subscript = PopValue();
+			Operand mov = mContext.NewVReg();
+			mContext.Emit(Ops(OpCode::Movi, mov, Operand::Imm(name.slot)));
+
+			// add base and offset
+			Operand addReg = mContext.NewVReg();
+			mContext.Emit(Ops(OpCode::Add, addReg, mov, subscript));
+
+			// load a value from the stack
+			Operand result = mContext.NewVReg();
+			mContext.Emit(Ops(OpCode::Load, result, addReg));
+			mValues.emplace_back(result);
+			break;
+		}
+		case NodeKind::AssignVarStmt:
+		{
+			const NameNode& name = mAst.GetName(node);
+			if (task.stage == 0) {
+				Push(node, 1);
+				Push(name.rhs);
+				break;
+			}
+
+			// store a register of data on the stack
+			mContext.Emit(Ops(OpCode::Storei, Operand::Stack(name.slot), PopValue()));
+			break;
+		}
+		case NodeKind::AssignArrayStmt:
+		{
+			const NameNode& name = mAst.GetName(node);
+			if (task.stage == 0) {
+				// rhs, then subscript
+				Push(node, 1);
+				Push(name.subscript);
+				Push(name.rhs);
+				break;
+			}
+
+			Operand subscript = PopValue();
+			Operand rhs = PopValue();
+
+			// set the base of the array to a register
+			Operand mov = mContext.NewVReg();
+			mContext.Emit(Ops(OpCode::Movi, mov, Operand::Imm(name.slot)));
+
+			// add base and offset
+			Operand add = mContext.NewVReg();
+			mContext.Emit(Ops(OpCode::Add, add, mov, subscript));
+
+			// store the value of a second register in the space of a first register
+			mContext.Emit(Ops(OpCode::Store, add, rhs));
+			break;
+		}
+		case NodeKind::IncStmt:
+			GenStep(node, OpCode::Inc);
+			break;
+		case NodeKind::DecStmt:
+			GenStep(node, OpCode::Dec);
+			break;
+		case NodeKind::IfStmt:
+		{
+			const BranchNode& branch = mAst.GetBranch(node);
+			switch (task.stage)
+			{
+			case 0:
+				Push(node, 1);
+				Push(branch.comp);
+				break;
+			case 1:
+			{
+				// set data to register, the label is placed after the if block
+				Operand first = mContext.NewVReg();
+				Operand elseLabel = mContext.NewLabel();
+				mContext.Emit(Ops(OpCode::Movi, first, elseLabel));
+
+				// if false, sets the pc to the reg
+				mContext.Emit(Ops(OpCode::Jnt, first));
+
+				// if block
+				Push(node, 2, elseLabel.value);
+				PushList(branch.block);
+				break;
+			}
+			case 2:
+				// no else block
+				if (branch.elseBlock.IsNone()) {
+					mContext.PlaceLabel(Operand::Label(task.first));
+				}
+				// else block
+				else {
+					// movi
+					Operand elsefi = mContext.NewVReg();
+					Operand fiLabel = mContext.NewLabel();
+					mContext.Emit(Ops(OpCode::Movi, elsefi, fiLabel));
+
+					// jmp
+					// sets pc to the reg
+					mContext.Emit(Ops(OpCode::Jmp, elsefi));
+
+					// 1st target: start of the else block
+					mContext.PlaceLabel(Operand::Label(task.first));
+
+					// else
+					Push(node, 3, fiLabel.value);
+					PushList(branch.elseBlock);
+				}
+				break;
+			default:
+				// 2nd target: after the else block
+				mContext.PlaceLabel(Operand::Label(task.first));
+				break;
+			}
+			break;
+		}
+		case NodeKind::WhileStmt:
+		{
+			const BranchNode& branch = mAst.GetBranch(node);
+			switch (task.stage)
+			{
+			case 0:
+			{
+				// the loop jumps back to the condition
+				Operand top = mContext.NewLabel();
+				mContext.PlaceLabel(top);
+				Push(node, 1, top.value);
+				Push(branch.comp);
+				break;
+			}
+			case 1:
+			{
+				Operand first = mContext.NewVReg();
+				Operand end = mContext.NewLabel();
+				mContext.Emit(Ops(OpCode::Movi, first, end));
+
+				mContext.Emit(Ops(OpCode::Jnt, first));
+
+				Push(node, 2, task.first, end.value);
+				PushList(branch.block);
+				break;
+			}
+			default:
+			{
+				Operand second = mContext.NewVReg();
+				mContext.Emit(Ops(OpCode::Movi, second, Operand::Label(task.first)));
+
+				mContext.Emit(Ops(OpCode::Jmp, second));
+
+				mContext.PlaceLabel(Operand::Label(task.second));
+				break;
+			}
+			}
+			break;
+		}
+		case NodeKind::PenUpStmt:
+			mContext.Emit(Ops(OpCode::PenUp));
+			break;
+		case NodeKind::PenDownStmt:
+			mContext.Emit(Ops(OpCode::PenDown));
+			break;
+		case NodeKind::SetColorStmt:
+		case NodeKind::FwdStmt:
+		case NodeKind::BackStmt:
+		case NodeKind::RotStmt:
+		{
+			if (task.stage == 0) {
+				Push(node, 1);
+				Push(mAst.GetUnary(node).child);
+				break;
+			}
+
+			Operand param = PopValue();
+			if (node.GetKind() == NodeKind::SetColorStmt) {
+				mContext.Emit(Ops(OpCode::Mov, Operand::Special(SpecialReg::Tc), param));
+			}
+			else if (node.GetKind() == NodeKind::FwdStmt) {
+				mContext.Emit(Ops(OpCode::Fwd, param));
+			}
+			else if (node.GetKind() == NodeKind::BackStmt) {
+				mContext.Emit(Ops(OpCode::Back, param));
+			}
+			else {
+				Operand tr = Operand::Special(SpecialReg::Tr);
+				mContext.Emit(Ops(OpCode::Add, tr, tr, param));
+			}
+			break;
+		}
+		case NodeKind::Numeric:
+			break;
+		}
 	}
-	// else block
-	else {
-		// movi
-		Ops elsemov("movi");
-		std::string elsefi = "%" + std::to_string(context.lastVRegIndex);
-		context.lastVRegIndex++;
-		std::string re = "??";
-		elsemov.params.emplace_back(elsefi);
-		elsemov.params.emplace_back(re);
-		context.opsVector.emplace_back(elsemov);
-		int tempelse = context.opsVector.size();
-		
-		// jmp
-		// sets pc to the reg
-		Ops jmp("jmp");
-		jmp.params.emplace_back(elsefi);
-		context.opsVector.emplace_back(jmp);
-
-		// fix up 1st address
-		std::string fStr = std::to_string(context.opsVector.size());
-		context.opsVector[temp - 1].params[1] = fStr;
-
-		// else
-		mElseBlock->CodeGen(context);
-
-		// fix up 2nd address
-		std::string sStr = std::to_string(context.opsVector.size());
-		context.opsVector[tempelse - 1].params[1] = sStr;
-	}
-}
-
-void NWhileStmt::CodeGen(CodeContext& context)
-{
-	int orig = context.opsVector.size();
-	mComp->CodeGen(context);
-
-	Ops mov("movi");
-	std::string first = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	std::string qu = "??";
-	mov.params.emplace_back(first);
-	mov.params.emplace_back(qu);
-	context.opsVector.emplace_back(mov);
-	int temp = context.opsVector.size();
-
-	Ops jnt("jnt");
-	jnt.params.emplace_back(first);
-	context.opsVector.emplace_back(jnt);
-
-	mBlock->CodeGen(context);
-
-	Ops mov2("movi");
-	std::string second = "%" + std::to_string(context.lastVRegIndex);
-	context.lastVRegIndex++;
-	mov2.params.emplace_back(second);
-	mov2.params.emplace_back(std::to_string(orig));
-	context.opsVector.emplace_back(mov2);
-
-	Ops jmp("jmp");
-	jmp.params.emplace_back(second);
-	context.opsVector.emplace_back(jmp);
-
-	std::string sStr = std::to_string(context.opsVector.size());
-	context.opsVector[temp - 1].params[1] = sStr;
-}
-
-void NPenUpStmt::CodeGen(CodeContext& context)
-{
-	Ops penUp("penup");
-	context.opsVector.emplace_back(penUp);
-}
-
-void NPenDownStmt::CodeGen(CodeContext& context)
-{
-	Ops penUp("pendown");
-	context.opsVector.emplace_back(penUp);
-}
-
-void NSetPosStmt::CodeGen(CodeContext& context)
-{
-	// genereate x, y expr
-	mXExpr->CodeGen(context);
-	mYExpr->CodeGen(context);
-
-	Ops movTx("mov");
-	movTx.params.emplace_back("tx");
-	movTx.params.emplace_back(mXExpr->GetResultRegister());
-	context.opsVector.emplace_back(movTx);
-
-	Ops movTy("mov");
-	movTy.params.emplace_back("ty");
-	movTy.params.emplace_back(mYExpr->GetResultRegister());
-	context.opsVector.emplace_back(movTy);
-}
-
-void NSetColorStmt::CodeGen(CodeContext& context)
-{
-	mColor->CodeGen(context);
-
-	Ops movTc("mov");
-	movTc.params.emplace_back("tc");
-	movTc.params.emplace_back(mColor->GetResultRegister());
-	context.opsVector.emplace_back(movTc);
-}
-
-void NFwdStmt::CodeGen(CodeContext& context)
-{
-	mParam->CodeGen(context);
-
-	Ops fwd("fwd");
-	fwd.params.emplace_back(mParam->GetResultRegister());
-	context.opsVector.emplace_back(fwd);
 }
 
-void NBackStmt::CodeGen(CodeContext& context)
+void CodeGen(const Ast& ast, CodeContext& context)
 {
-	mParam->CodeGen(context);
-
-	Ops back("back");
-	back.params.emplace_back(mParam->GetResultRegister());
-	context.opsVector.emplace_back(back);
-}
-
-void NRotStmt::CodeGen(CodeContext& context)
-{
-	mParam->CodeGen(context);
-
-	Ops add("add");
-	add.params.emplace_back("tr");
-	add.params.emplace_back("tr");
-	add.params.emplace_back(mParam->GetResultRegister());
-	context.opsVector.emplace_back(add);
+	CodeGenWalker walker(ast, context);
+	walker.Run(ast.GetData());
+	walker.Run(ast.GetMain());
+	// at this point, the final stage is to exit the program
+	context.Emit(Ops(OpCode::Exit));
 }
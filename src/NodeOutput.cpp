@@ -1,264 +1,306 @@
 #include "Node.h"
 #include "parser.hpp"
+#include "TextWriter.h"
+#include <vector>
 
 // This file outputs Node identities to the ast output file based on
 // the symbol definitions in Procc.y
 
-// new node identified
-// lists additional nodes depending on their depth in the original code. 
-// Ex: variables declared in an if statement are of greater 
-// depth than variables declared before the if statement
-void Node::OutputMargin(std::ostream& stream, int depth) const
+namespace
 {
-	for (int i = 0; i < depth; i++)
-	{
-		stream << "--";
-	}
-}
+	// "--" for each level, written as one slice of this rather than pair by pair
+	const char kMargin[] =
+		"----------------------------------------------------------------"
+		"----------------------------------------------------------------"
+		"----------------------------------------------------------------"
+		"----------------------------------------------------------------";
+	const int kMarginDepth = (sizeof(kMargin) - 1) / 2;
 
-// Block Node - Identified as one or more statements
-void NBlock::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "Block\n";
-	for (auto& stmt : mStatements)
+	// new node identified
+	// lists additional nodes depending on their depth in the original code.
+	// Ex: variables declared in an if statement are of greater
+	// depth than variables declared before the if statement
+	void OutputMargin(TextWriter& out, int depth)
 	{
-		stmt->OutputAST(stream, depth + 1);
-		stream.flush();
+		while (depth > kMarginDepth)
+		{
+			out.Write(kMargin, sizeof(kMargin) - 1);
+			depth -= kMarginDepth;
+		}
+		out.Write(kMargin, static_cast<size_t>(depth) * 2);
 	}
-}
 
-// Data definition (struct like object at top of code that declares all 
-// variables we will use in main code)
-void NData::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "Data\n";
-	for (auto& decl : mDecls)
+	const char* BinaryOpName(int op)
 	{
-		decl->OutputAST(stream, depth + 1);
+		switch (op)
+		{
+		case TADD:
+			return "+";
+		case TSUB:
+			return "-";
+		case TMUL:
+			return "*";
+		case TDIV:
+			return "/";
+		default:
+			return " ";
+		}
 	}
-}
-
-// Program definition (data + main/block)
-void NProgram::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "Program\n";
-	mData->OutputAST(stream, depth + 1);
-	mMain->OutputAST(stream, depth + 1);
-}
-
-// Defines any collection of integers 
-void NNumeric::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "Numeric: " << mValue << '\n';
-}
-
-// Variable Declaration 
-void NVarDecl::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "VarDecl: " << mName << '\n';
-}
-
-// Array Declaration
-void NArrayDecl::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "ArrayDecl: " << mName << '\n';
-	mSize->OutputAST(stream, depth + 1);
-}
-
-// Numeric Expression (integer is part of expression)
-void NNumericExpr::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "NumericExpr\n";
-	mNumeric->OutputAST(stream, depth + 1);
-}
 
-// Variable Expression (defined variable is part of expression)
-void NVarExpr::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "VarExpr: " << mName << '\n';
-}
-
-// Binary Expression (arithmetic)
-void NBinaryExpr::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	
-	char op = ' ';
-	switch (mType)
+	const char* ComparisonOpName(int op)
 	{
-	case TADD:
-		op = '+';
-		break;
-	case TSUB:
-		op = '-';
-		break;
-	case TMUL:
-		op = '*';
-		break;
-	case TDIV:
-		op = '/';
-		break;
-	default:
-		break;
+		switch (op)
+		{
+		case TLESS:
+			return "<";
+		case TISEQUAL:
+			return "==";
+		default:
+			return "";
+		}
 	}
 
-	stream << "BinaryExpr: " << op << '\n';
-	mLhs->OutputAST(stream, depth + 1);
-	mRhs->OutputAST(stream, depth + 1);
-}
+	struct OutputFrame
+	{
+		NodeRef node;
+		int depth;
+	};
 
-// Array Expression (defined array is part of expression)
-void NArrayExpr::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "ArrayExpr: " << mName << '\n';
-	mSubscript->OutputAST(stream, depth + 1);
-}
+	// Writes the tree in pre-order with an explicit stack, so nesting depth is
+	// limited by heap memory and not the thread's stack. Children are pushed
+	// last to first so they come off the stack in order.
+	class OutputWalker
+	{
+	public:
+		OutputWalker(TextWriter& out, const Ast& ast, const SymbolTable& symbols)
+			:mOut(out)
+			,mAst(ast)
+			,mSymbols(symbols)
+		{ }
 
-// Var Assignment Statement
-void NAssignVarStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "AssignVarStmt: " << mName << '\n';
-	mRhs->OutputAST(stream, depth + 1);
-}
+		void Run(NodeRef root, int depth);
 
-// Array Assignment Statement
-void NAssignArrayStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "AssignArrayStmt: " << mName << '\n';
-	mSubscript->OutputAST(stream, depth + 1);
-	mRhs->OutputAST(stream, depth + 1);
-}
+	private:
+		void Push(NodeRef node, int depth) { mFrames.emplace_back(OutputFrame{ node, depth }); }
 
-// Increment ++
-void NIncStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "IncStmt: " << mName << '\n';
-}
+		void PushList(NodeRef node, int depth)
+		{
+			const ListNode& list = mAst.GetList(node);
+			for (uint32_t i = list.count; i > 0; i--)
+			{
+				Push(mAst.GetListItem(list, i - 1), depth);
+			}
+		}
 
-// Decrement --
-void NDecStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "DecStmt: " << mName << '\n';
-}
+		void Visit(NodeRef node, int depth);
 
-// Comparison Operators
-void NComparison::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
+		TextWriter& mOut;
+		const Ast& mAst;
+		const SymbolTable& mSymbols;
+		std::vector<OutputFrame> mFrames;
+	};
 
-	std::string op;
-	switch (mType)
+	void OutputWalker::Run(NodeRef root, int depth)
 	{
-	case TLESS:
-		op = "<";
-		break;
-	case TISEQUAL:
-		op = "==";
-		break;
-	default:
-		break;
+		Push(root, depth);
+		while (!mFrames.empty())
+		{
+			OutputFrame frame = mFrames.back();
+			mFrames.pop_back();
+			Visit(frame.node, frame.depth);
+		}
 	}
 
-	stream << "Comparison: " << op << '\n';
-	mLhs->OutputAST(stream, depth + 1);
-	mRhs->OutputAST(stream, depth + 1);
-}
-
-// If Statement
-void NIfStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-
-	if (mElseBlock == nullptr)
+	void OutputWalker::Visit(NodeRef node, int depth)
 	{
-		stream << "IfStmt (no else)\n";
-	}
-	else
-	{
-		stream << "IfStmt (with else)\n";
-	}
-	
-	mComp->OutputAST(stream, depth + 1);
-	mIfBlock->OutputAST(stream, depth + 1);
-	if (mElseBlock != nullptr)
-	{
-		mElseBlock->OutputAST(stream, depth + 1);
-	}
-}
-
-//While Statement
-void NWhileStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "WhileStmt\n";
-	mComp->OutputAST(stream, depth + 1);
-	mBlock->OutputAST(stream, depth + 1);
-}
+		TextWriter& out = mOut;
+		const Ast& ast = mAst;
+		const SymbolTable& symbols = mSymbols;
+		OutputMargin(out, depth);
 
-// Lifts Pen (for drawing to screen)
-void NPenUpStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "PenUpStmt\n";
-}
-
-// Drops Pen onto "canvas" (for drawing to screen)
-void NPenDownStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "PenDownStmt\n";
-}
-
-// Sets Position of Pen
-void NSetPosStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "SetPosStmt\n";
-	mXExpr->OutputAST(stream, depth + 1);
-	mYExpr->OutputAST(stream, depth + 1);
-}
-
-// Sets Color
-void NSetColorStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "SetColorStmt\n";
-	mColor->OutputAST(stream, depth + 1);
-}
-
-// Pen Move forward statement
-void NFwdStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "FwdStmt\n";
-	mParam->OutputAST(stream, depth + 1);
-}
-
-// Pen Back Statement
-void NBackStmt::OutputAST(std::ostream& stream, int depth) const
-{
-	OutputMargin(stream, depth);
-	stream << "BackStmt\n";
-	mParam->OutputAST(stream, depth + 1);
+		switch (node.GetKind())
+		{
+		// Block Node - Identified as one or more statements
+		case NodeKind::Block:
+			out.Write("Block\n");
+			PushList(node, depth + 1);
+			break;
+		// Data definition (struct like object at top of code that declares all
+		// variables we will use in main code)
+		case NodeKind::Data:
+			out.Write("Data\n");
+			PushList(node, depth + 1);
+			break;
+		// Defines any collection of integers
+		case NodeKind::Numeric:
+			out.Write("Numeric: ");
+			out.WriteInt(ast.GetNumeric(node));
+			out.Write('\n');
+			break;
+		// Variable Declaration
+		case NodeKind::VarDecl:
+			out.Write("VarDecl: ");
+			out.Write(symbols.GetName(ast.GetDecl(node).symbol));
+			out.Write('\n');
+			break;
+		// Array Declaration
+		case NodeKind::ArrayDecl:
+		{
+			const DeclNode& decl = ast.GetDecl(node);
+			out.Write("ArrayDecl: ");
+			out.Write(symbols.GetName(decl.symbol));
+			out.Write('\n');
+			Push(decl.size, depth + 1);
+			break;
+		}
+		// Numeric Expression (integer is part of expression)
+		case NodeKind::NumericExpr:
+			out.Write("NumericExpr\n");
+			Push(ast.GetUnary(node).child, depth + 1);
+			break;
+		// Variable Expression (defined variable is part of expression)
+		case NodeKind::VarExpr:
+			out.Write("VarExpr: ");
+			out.Write(symbols.GetName(ast.GetName(node).symbol));
+			out.Write('\n');
+			break;
+		// Binary Expression (arithmetic)
+		case NodeKind::BinaryExpr:
+		{
+			const BinaryNode& binary = ast.GetBinary(node);
+			out.Write("BinaryExpr: ");
+			out.Write(BinaryOpName(binary.op));
+			out.Write('\n');
+			Push(binary.rhs, depth + 1);
+			Push(binary.lhs, depth + 1);
+			break;
+		}
+		// Array Expression (defined array is part of expression)
+		case NodeKind::ArrayExpr:
+		{
+			const NameNode& name = ast.GetName(node);
+			out.Write("ArrayExpr: ");
+			out.Write(symbols.GetName(name.symbol));
+			out.Write('\n');
+			Push(name.subscript, depth + 1);
+			break;
+		}
+		// Var Assignment Statement
+		case NodeKind::AssignVarStmt:
+		{
+			const NameNode& name = ast.GetName(node);
+			out.Write("AssignVarStmt: ");
+			out.Write(symbols.GetName(name.symbol));
+			out.Write('\n');
+			Push(name.rhs, depth + 1);
+			break;
+		}
+		// Array Assignment Statement
+		case NodeKind::AssignArrayStmt:
+		{
+			const NameNode& name = ast.GetName(node);
+			out.Write("AssignArrayStmt: ");
+			out.Write(symbols.GetName(name.symbol));
+			out.Write('\n');
+			Push(name.rhs, depth + 1);
+			Push(name.subscript, depth + 1);
+			break;
+		}
+		// Increment ++
+		case NodeKind::IncStmt:
+			out.Write("IncStmt: ");
+			out.Write(symbols.GetName(ast.GetName(node).symbol));
+			out.Write('\n');
+			break;
+		// Decrement --
+		case NodeKind::DecStmt:
+			out.Write("DecStmt: ");
+			out.Write(symbols.GetName(ast.GetName(node).symbol));
+			out.Write('\n');
+			break;
+		// Comparison Operators
+		case NodeKind::Comparison:
+		{
+			const BinaryNode& binary = ast.GetBinary(node);
+			out.Write("Comparison: ");
+			out.Write(ComparisonOpName(binary.op));
+			out.Write('\n');
+			Push(binary.rhs, depth + 1);
+			Push(binary.lhs, depth + 1);
+			break;
+		}
+		// If Statement
+		case NodeKind::IfStmt:
+		{
+			const BranchNode& branch = ast.GetBranch(node);
+			if (branch.elseBlock.IsNone())
+			{
+				out.Write("IfStmt (no else)\n");
+			}
+			else
+			{
+				out.Write("IfStmt (with else)\n");
+				Push(branch.elseBlock, depth + 1);
+			}
+			Push(branch.block, depth + 1);
+			Push(branch.comp, depth + 1);
+			break;
+		}
+		//While Statement
+		case NodeKind::WhileStmt:
+		{
+			const BranchNode& branch = ast.GetBranch(node);
+			out.Write("WhileStmt\n");
+			Push(branch.block, depth + 1);
+			Push(branch.comp, depth + 1);
+			break;
+		}
+		// Lifts Pen (for drawing to screen)
+		case NodeKind::PenUpStmt:
+			out.Write("PenUpStmt\n");
+			break;
+		// Drops Pen onto "canvas" (for drawing to screen)
+		case NodeKind::PenDownStmt:
+			out.Write("PenDownStmt\n");
+			break;
+		// Sets Position of Pen
+		case NodeKind::SetPosStmt:
+		{
+			const BinaryNode& binary = ast.GetBinary(node);
+			out.Write("SetPosStmt\n");
+			Push(binary.rhs, depth + 1);
+			Push(binary.lhs, depth + 1);
+			break;
+		}
+		// Sets Color
+		case NodeKind::SetColorStmt:
+			out.Write("SetColorStmt\n");
+			Push(ast.GetUnary(node).child, depth + 1);
+			break;
+		// Pen Move forward statement
+		case NodeKind::FwdStmt:
+			out.Write("FwdStmt\n");
+			Push(ast.GetUnary(node).child, depth + 1);
+			break;
+		// Pen Back Statement
+		case NodeKind::BackStmt:
+			out.Write("BackStmt\n");
+			Push(ast.GetUnary(node).child, depth + 1);
+			break;
+		// Pen Rotate Statement
+		case NodeKind::RotStmt:
+			out.Write("RotStmt\n");
+			Push(ast.GetUnary(node).child, depth + 1);
+			break;
+		}
+	}
 }
 
-// Pen Rotate Statement
-void NRotStmt::OutputAST(std::ostream& stream, int depth) const
+// Program definition (data + main/block)
+void OutputAST(TextWriter& out, const Ast& ast, const SymbolTable& symbols)
 {
-	OutputMargin(stream, depth);
-	stream << "RotStmt\n";
-	mParam->OutputAST(stream, depth + 1);
+	out.Write("Program\n");
+	OutputWalker walker(out, ast, symbols);
+	walker.Run(ast.GetData(), 1);
+	walker.Run(ast.GetMain(), 1);
 }
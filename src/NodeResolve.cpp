@@ -0,0 +1,148 @@
+#include "Node.h"
+#include "ResolveContext.h"
+#include <vector>
+
+// This file binds every name in the program to its stack slot before codegen
+
+const int ResolveContext::kUndeclared;
+const int ResolveContext::kReported;
+
+int ResolveContext::Declare(int symbol, int size, bool array)
+{
+	if (slots[symbol] >= 0)
+	{
+		diag << "ERROR: Duplicate declaration of '" << symbols.GetName(symbol) << "'" << std::endl;
+		numErrors++;
+	}
+
+	// a duplicate still takes up stack space, codegen pushes it all the same
+	slots[symbol] = lastStackIndex;
+	arrays[symbol] = array;
+	lastStackIndex += size;
+	return slots[symbol];
+}
+
+int ResolveContext::Lookup(int symbol, bool subscripted)
+{
+	int slot = slots[symbol];
+	if (slot >= 0)
+	{
+		// a var's slot can't be reached through a computed address, the
+		// passes keep vars in registers
+		if (subscripted && !arrays[symbol])
+		{
+			diag << "ERROR: '" << symbols.GetName(symbol) << "' is not an array" << std::endl;
+			numErrors++;
+		}
+		else if (!subscripted && arrays[symbol])
+		{
+			diag << "ERROR: Array '" << symbols.GetName(symbol) << "' used without a subscript" << std::endl;
+			numErrors++;
+		}
+		return slot;
+	}
+
+	if (slot == kUndeclared)
+	{
+		diag << "ERROR: Undeclared identifier '" << symbols.GetName(symbol) << "'" << std::endl;
+		slots[symbol] = kReported;
+	}
+	numErrors++;
+	return 0;
+}
+
+namespace
+{
+	// pre-order walk with an explicit stack, like OutputAST and CodeGen
+	void ResolveTree(Ast& ast, ResolveContext& context, NodeRef root)
+	{
+		std::vector<NodeRef> stack;
+		stack.emplace_back(root);
+
+		// children are pushed last to first so names are looked up in source order
+		auto push = [&stack](NodeRef node) {
+			if (!node.IsNone())
+			{
+				stack.emplace_back(node);
+			}
+		};
+
+		while (!stack.empty())
+		{
+			NodeRef node = stack.back();
+			stack.pop_back();
+
+			switch (node.GetKind())
+			{
+			case NodeKind::Data:
+			case NodeKind::Block:
+			{
+				const ListNode& list = ast.GetList(node);
+				for (uint32_t i = list.count; i > 0; i--)
+				{
+					push(ast.GetListItem(list, i - 1));
+				}
+				break;
+			}
+			case NodeKind::VarDecl:
+				context.Declare(ast.GetDecl(node).symbol, 1, false);
+				break;
+			case NodeKind::ArrayDecl:
+			{
+				const DeclNode& decl = ast.GetDecl(node);
+				context.Declare(decl.symbol, ast.GetNumeric(decl.size), true);
+				break;
+			}
+			case NodeKind::VarExpr:
+			case NodeKind::ArrayExpr:
+			case NodeKind::AssignVarStmt:
+			case NodeKind::AssignArrayStmt:
+			case NodeKind::IncStmt:
+			case NodeKind::DecStmt:
+			{
+				NameNode& name = ast.GetName(node);
+				name.slot = context.Lookup(name.symbol,
+					node.GetKind() == NodeKind::ArrayExpr || node.GetKind() == NodeKind::AssignArrayStmt);
+				push(name.rhs);
+				push(name.subscript);
+				break;
+			}
+			case NodeKind::BinaryExpr:
+			case NodeKind::Comparison:
+			case NodeKind::SetPosStmt:
+			{
+				const BinaryNode& binary = ast.GetBinary(node);
+				push(binary.rhs);
+				push(binary.lhs);
+				break;
+			}
+			case NodeKind::IfStmt:
+			case NodeKind::WhileStmt:
+			{
+				const BranchNode& branch = ast.GetBranch(node);
+				push(branch.elseBlock);
+				push(branch.block);
+				push(branch.comp);
+				break;
+			}
+			case NodeKind::NumericExpr:
+			case NodeKind::SetColorStmt:
+			case NodeKind::FwdStmt:
+			case NodeKind::BackStmt:
+			case NodeKind::RotStmt:
+				push(ast.GetUnary(node).child);
+				break;
+			case NodeKind::Numeric:
+			case NodeKind::PenUpStmt:
+			case NodeKind::PenDownStmt:
+				break;
+			}
+		}
+	}
+}
+
+void Resolve(Ast& ast, ResolveContext& context)
+{
+	ResolveTree(ast, context, ast.GetData());
+	ResolveTree(ast, context, ast.GetMain());
+}
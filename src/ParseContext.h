@@ -0,0 +1,33 @@
+#pragma once
+#include "Node.h"
+#include "SymbolTable.h"
+#include <iostream>
+
+// ParseContext
+// everything the scanner and parser need for one compilation, so several
+// compilations can run side by side without sharing any mutable state.
+// The scanner reaches it through yyextra, the parser through its parse-param.
+struct ParseContext
+{
+	explicit ParseContext(Ast& tree)
+		:ast(tree)
+	{ }
+
+	// the tree being built, its root is set once the whole program has been reduced
+	Ast& ast;
+
+	// every identifier the scanner has seen, by symbol id
+	SymbolTable symbols;
+
+	// line the scanner is on, for error messages
+	int lineNumber = 1;
+
+	// set by proccerror
+	bool syntaxError = false;
+
+	// echo each grammar reduction to diag
+	bool trace = false;
+
+	// where syntax errors and traces are written
+	std::ostream* diag = &std::cout;
+};
@@ -0,0 +1,152 @@
+#include "PassManager.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "DeadCode.h"
+#include "LICM.h"
+#include "SCCP.h"
+#include "SSA.h"
+
+const CFG& Analyses::GetCFG()
+{
+	if (!mHasCfg)
+	{
+		mCfg.Build(mProgram);
+		mHasCfg = true;
+	}
+	return mCfg;
+}
+
+const Liveness& Analyses::GetLiveness()
+{
+	if (!mHasLiveness)
+	{
+		mLiveness.Build(mProgram, GetCFG());
+		mHasLiveness = true;
+	}
+	return mLiveness;
+}
+
+void Analyses::Invalidate()
+{
+	mHasCfg = false;
+	mHasLiveness = false;
+}
+
+namespace
+{
+	bool RunBuildSSA(CodeContext& program, Analyses& analyses)
+	{
+		BuildSSA(program, analyses.GetCFG());
+		return true;
+	}
+
+	bool RunDestroySSA(CodeContext& program, Analyses& analyses)
+	{
+		if (program.phis.empty())
+		{
+			return false;
+		}
+		DestroySSA(program, analyses.GetCFG());
+		return true;
+	}
+
+	bool RunPropagateConstants(CodeContext& program, Analyses& analyses)
+	{
+		return PropagateConstants(program, analyses.GetCFG());
+	}
+
+	bool RunRemoveDeadStores(CodeContext& program, Analyses& analyses)
+	{
+		return RemoveDeadStores(program, analyses.GetCFG());
+	}
+
+	bool RunRemoveDeadCode(CodeContext& program, Analyses&)
+	{
+		return RemoveDeadCode(program);
+	}
+
+	bool RunHoistLoopInvariants(CodeContext& program, Analyses& analyses)
+	{
+		return HoistLoopInvariants(program, analyses.GetCFG(), analyses.GetLiveness());
+	}
+
+	// Passes that work on SSA values go between ssa and out-of-ssa
+	const std::vector<Pass> kPipelines[kMaxOptLevel + 1] = {
+		// -O0
+		{ },
+		// -O1
+		{
+			{ "ssa", RunBuildSSA },
+			{ "sccp", RunPropagateConstants },
+			{ "dse", RunRemoveDeadStores },
+			{ "dce", RunRemoveDeadCode },
+			{ "out-of-ssa", RunDestroySSA },
+		},
+		// -O2
+		{
+			{ "ssa", RunBuildSSA },
+			{ "sccp", RunPropagateConstants },
+			{ "dse", RunRemoveDeadStores },
+			{ "dce", RunRemoveDeadCode },
+			{ "licm", RunHoistLoopInvariants },
+			{ "out-of-ssa", RunDestroySSA },
+		},
+	};
+
+	// instructions in the final program, as LayoutProgram counts them
+	int CountInstructions(const CodeContext& program)
+	{
+		int count = 0;
+		for (auto& ops : program.opsVector)
+		{
+			count += ops.op != OpCode::Label;
+		}
+		return count;
+	}
+}
+
+const std::vector<Pass>& GetPipeline(int level)
+{
+	return kPipelines[level < 0 ? 0 : level > kMaxOptLevel ? kMaxOptLevel : level];
+}
+
+void PassManager::Remove(const char* name)
+{
+	mPasses.erase(std::remove_if(mPasses.begin(), mPasses.end(),
+		[name](const Pass& pass) { return std::strcmp(pass.name, name) == 0; }), mPasses.end());
+}
+
+void PassManager::Run()
+{
+	for (const Pass& pass : mPasses)
+	{
+		PassStats stats;
+		stats.name = pass.name;
+		stats.instructionsBefore = CountInstructions(mProgram);
+
+		auto start = std::chrono::steady_clock::now();
+		if (pass.run(mProgram, mAnalyses))
+		{
+			mAnalyses.Invalidate();
+		}
+		stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		stats.instructionsAfter = CountInstructions(mProgram);
+		mStats.emplace_back(stats);
+	}
+}
+
+void OutputPassStats(std::ostream& out, const std::vector<PassStats>& stats)
+{
+	char line[128];
+	std::snprintf(line, sizeof(line), "%-16s %10s %12s %8s\n", "pass", "time (ms)", "instructions", "delta");
+	out << line;
+	for (const PassStats& pass : stats)
+	{
+		std::snprintf(line, sizeof(line), "%-16s %10.3f %12d %+8d\n", pass.name, pass.seconds * 1000.0,
+			pass.instructionsAfter, pass.instructionsAfter - pass.instructionsBefore);
+		out << line;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <ostream>
+#include <vector>
+#include "CFG.h"
+#include "IR.h"
+#include "Liveness.h"
+
+// Analyses
+// results computed from the program that passes (and register allocation)
+// share. Each one is built the first time it is asked for and kept until the
+// program changes; dominators and loops come with the CFG.
+class Analyses
+{
+public:
+	explicit Analyses(const CodeContext& program)
+		:mProgram(program)
+	{ }
+
+	const CFG& GetCFG();
+	const Liveness& GetLiveness();
+
+	// drops everything; called after a pass changed the program
+	void Invalidate();
+
+private:
+	const CodeContext& mProgram;
+
+	CFG mCfg;
+	bool mHasCfg = false;
+	Liveness mLiveness;
+	bool mHasLiveness = false;
+};
+
+// Pass
+// one transformation of the program. run returns true if it changed
+// anything, which invalidates the cached analyses.
+struct Pass
+{
+	const char* name;
+	bool (*run)(CodeContext& program, Analyses& analyses);
+};
+
+// what one pass cost and what it did to the program's size
+struct PassStats
+{
+	const char* name;
+	double seconds = 0.0;
+	int instructionsBefore = 0;
+	int instructionsAfter = 0;
+};
+
+// highest level GetPipeline knows
+const int kMaxOptLevel = 2;
+
+// passes run at -O<level>, in order; -O0 runs none
+const std::vector<Pass>& GetPipeline(int level);
+
+// PassManager
+// runs a pipeline over one program, timing every pass
+class PassManager
+{
+public:
+	explicit PassManager(CodeContext& program)
+		:mProgram(program)
+		,mAnalyses(program)
+	{ }
+
+	void Add(const Pass& pass) { mPasses.emplace_back(pass); }
+	void Add(const std::vector<Pass>& passes) { mPasses.insert(mPasses.end(), passes.begin(), passes.end()); }
+	// takes the passes called name back out of the pipeline
+	void Remove(const char* name);
+
+	void Run();
+
+	// analyses of the program as the last pass left it
+	Analyses& GetAnalyses() { return mAnalyses; }
+	// one entry per pass run, in order
+	const std::vector<PassStats>& GetStats() const { return mStats; }
+
+private:
+	CodeContext& mProgram;
+	Analyses mAnalyses;
+	std::vector<Pass> mPasses;
+	std::vector<PassStats> mStats;
+};
+
+// table of the time and instruction delta of every pass
+void OutputPassStats(std::ostream& out, const std::vector<PassStats>& stats);
@@ -2,28 +2,43 @@
 #include "Node.h"
 #include <iostream>
 #include <string>
-extern int yylex();
-extern void yyerror(const char* s);
 
-// Global for the program
-NProgram* gProgram = nullptr;
+// Grammar tracing, off unless the "trace" mode is passed on the command line.
+// Costs a single branch per reduction when disabled.
+#define PARSER_TRACE(x) do { if (ctx.trace) { *ctx.diag << x; } } while (0)
+
+// Bison's stack grows on the heap as needed; the default cap of 10000 entries
+// would reject deeply nested blocks or parentheses long before memory runs out
+#define YYMAXDEPTH 100000000
 
 // Disable the warnings that Bison creates
 #pragma warning(disable: 4065)
 %}
 
-/* You should not need to change the union */
+/* Needed by anything that includes parser.hpp */
+%code requires {
+#include "ParseContext.h"
+typedef void* yyscan_t;
+}
+
+/* Pure parser: all state is in the scanner and the ParseContext */
+%define api.pure full
+%lex-param { yyscan_t scanner }
+%parse-param { yyscan_t scanner }
+%parse-param { ParseContext& ctx }
+
+%code {
+extern int procclex(YYSTYPE* lvalp, yyscan_t scanner);
+extern void proccerror(yyscan_t scanner, ParseContext& ctx, const char* s);
+}
+
+/* Nodes are NodeRefs into ctx.ast; a list is where it starts on the
+   Ast's pending stack until the rule that owns it closes it */
 %union {
-    Node* node;
-	NProgram* program;
-	NData* data;
-	NDecl* decl;
-	NBlock* block;
-	NStatement* statement;
-	NNumeric* numeric;
-	NExpr* expr;
-	NComparison* comparison;
-	std::string* string;
+	NodeRef node;
+	unsigned list;
+	TokenText text;
+	int symbol;
 	int token;
 }
 
@@ -37,17 +52,12 @@ NProgram* gProgram = nullptr;
 %token <token> TVAR TARRAY
 %token <token> TIF TELSE TWHILE
 %token <token> TCOMMA TPENUP TPENDOWN TSETPOS TSETCOLOR TFWD TBACK TROT
-%token <string> TINTEGER TIDENTIFIER
+%token <text> TINTEGER
+%token <symbol> TIDENTIFIER
 
 /* Types/non-terminal symbols */
-%type <program> program
-%type <data> data decls
-%type <block> main block
-%type <decl> decl
-%type <numeric> numeric
-%type <expr> expr
-%type <statement> statement
-%type <comparison> cndn
+%type <node> data main decl numeric expr statement cndn
+%type <list> decls block
 
 /* Operator precedence */
 %left TADD TSUB
@@ -57,34 +67,34 @@ NProgram* gProgram = nullptr;
 
 program		: data main 
 				{ 
-					std::cout << "Program\n";
-					gProgram = new NProgram($1, $2);
+					PARSER_TRACE("Program\n");
+					ctx.ast.SetProgram($1, $2);
 				}
 ;
 
 data		: TDATA TLBRACE TRBRACE
 				{
-					std::cout << "Data (no decls)\n";
-					$$ = new NData();
+					PARSER_TRACE("Data (no decls)\n");
+					$$ = ctx.ast.EndList(NodeKind::Data, ctx.ast.BeginList());
 				}
 			| TDATA TLBRACE decls TRBRACE
 				{
-					std::cout << "Data\n";
-					$$ = $3;
+					PARSER_TRACE("Data\n");
+					$$ = ctx.ast.EndList(NodeKind::Data, $3);
 				}
 
 ;
 
 decls		: decl 
 				{
-					std::cout << "Single decl\n";
-					$$ = new NData();
-					$$->AddDecl($1);
+					PARSER_TRACE("Single decl\n");
+					$$ = ctx.ast.BeginList();
+					ctx.ast.AddToList($1);
 				}
 			| decls decl
 				{
-					std::cout << "Multiple decls\n";
-					$$->AddDecl($2);
+					PARSER_TRACE("Multiple decls\n");
+					ctx.ast.AddToList($2);
 
 
 				}
@@ -92,178 +102,187 @@ decls		: decl
 
 decl		: TVAR TIDENTIFIER TSEMI
 				{
-					std::cout << "Var declaration " << *($2) << '\n';
-					$$ = new NVarDecl(*($2));
+					PARSER_TRACE("Var declaration " << ctx.symbols.GetName($2) << '\n');
+					$$ = ctx.ast.AddDecl(NodeKind::VarDecl, $2, NodeRef::None());
 				}
 			| TARRAY TIDENTIFIER TLBRACKET numeric TRBRACKET TSEMI
 				{
-					std::cout << "Array declaration " << *($2) << '\n';
-					$$ = new NArrayDecl(*($2), $4);
+					PARSER_TRACE("Array declaration " << ctx.symbols.GetName($2) << '\n');
+					$$ = ctx.ast.AddDecl(NodeKind::ArrayDecl, $2, $4);
 				}
 ;
 
 main		: TMAIN TLBRACE TRBRACE
 				{
-					std::cout << "Main (no stmts)\n";
-					$$ = new NBlock();
+					PARSER_TRACE("Main (no stmts)\n");
+					$$ = ctx.ast.EndList(NodeKind::Block, ctx.ast.BeginList());
 				}
 			| TMAIN TLBRACE block TRBRACE
 				{
-					std::cout << "Main\n";
-					$$ = $3;
+					PARSER_TRACE("Main\n");
+					$$ = ctx.ast.EndList(NodeKind::Block, $3);
 				}
 ;
 
 statement		: TIDENTIFIER TEQUALS expr TSEMI
 				{
-					std::cout << "identifier assignment to expression\n";
-					$$ = new NAssignVarStmt((*$1), $3);
+					PARSER_TRACE("identifier assignment to expression\n");
+					$$ = ctx.ast.AddName(NodeKind::AssignVarStmt, $1, NodeRef::None(), $3);
 				}
 			| TINTEGER TEQUALS expr TSEMI
 				{
-					std::cout << "integer assignment to expression\n";
-					$$ = new NAssignVarStmt(*$1, $3);
+					PARSER_TRACE("integer assignment to expression\n");
+					$$ = ctx.ast.AddName(NodeKind::AssignVarStmt, ctx.symbols.Intern($1.text, $1.length), NodeRef::None(), $3);
 				}
 			| TIDENTIFIER TLBRACKET expr TRBRACKET TEQUALS expr TSEMI
 				{
-					std::cout << "array index assignment\n";
-					$$ = new NAssignArrayStmt(*$1, $3, $6);
+					PARSER_TRACE("array index assignment\n");
+					$$ = ctx.ast.AddName(NodeKind::AssignArrayStmt, $1, $3, $6);
 				}
 			| TINC TIDENTIFIER TSEMI
 				{
-					std::cout << "increment statement\n";
-					$$ = new NIncStmt(*$2);
+					PARSER_TRACE("increment statement\n");
+					$$ = ctx.ast.AddName(NodeKind::IncStmt, $2, NodeRef::None(), NodeRef::None());
 				}
 			| TDEC TIDENTIFIER TSEMI
 				{
-					std::cout << "decrement statement\n";
-					$$ = new NDecStmt(*$2);
+					PARSER_TRACE("decrement statement\n");
+					$$ = ctx.ast.AddName(NodeKind::DecStmt, $2, NodeRef::None(), NodeRef::None());
 				}
 			| TIF cndn TLBRACE block TRBRACE
 				{
-					std::cout << "if statement\n";
-					$$ = new NIfStmt($2, $4, nullptr);
+					PARSER_TRACE("if statement\n");
+					$$ = ctx.ast.AddBranch(NodeKind::IfStmt, $2, ctx.ast.EndList(NodeKind::Block, $4), NodeRef::None());
 				}
 			| TIF cndn TLBRACE block TRBRACE TELSE TLBRACE block TRBRACE
 				{
-					std::cout << "if / else statement\n";
-					$$ = new NIfStmt($2, $4, $8);
+					PARSER_TRACE("if / else statement\n");
+					// the else block is on top of the if block on the pending stack
+					NodeRef elseBlock = ctx.ast.EndList(NodeKind::Block, $8);
+					NodeRef ifBlock = ctx.ast.EndList(NodeKind::Block, $4);
+					$$ = ctx.ast.AddBranch(NodeKind::IfStmt, $2, ifBlock, elseBlock);
 				}
 			| TWHILE cndn TLBRACE block TRBRACE
 				{
-					std::cout << "while statement\n";
-					$$ = new NWhileStmt($2, $4);
+					PARSER_TRACE("while statement\n");
+					$$ = ctx.ast.AddBranch(NodeKind::WhileStmt, $2, ctx.ast.EndList(NodeKind::Block, $4), NodeRef::None());
 				}
 			| TPENUP TLPAREN TRPAREN TSEMI
 				{
-					std::cout << "pen up function\n";
-					$$ = new NPenUpStmt();
+					PARSER_TRACE("pen up function\n");
+					$$ = ctx.ast.AddLeaf(NodeKind::PenUpStmt);
 				}
 			| TPENDOWN TLPAREN TRPAREN TSEMI
 				{
-					std::cout << "pen down function\n";
-					$$ = new NPenDownStmt();
+					PARSER_TRACE("pen down function\n");
+					$$ = ctx.ast.AddLeaf(NodeKind::PenDownStmt);
 				}
 			| TSETPOS TLPAREN expr TCOMMA expr TRPAREN TSEMI
 				{
-					std::cout << "set position function\n";
-					$$ = new NSetPosStmt($3, $5);
+					PARSER_TRACE("set position function\n");
+					$$ = ctx.ast.AddBinary(NodeKind::SetPosStmt, $3, 0, $5);
 				}
 			| TSETCOLOR TLPAREN expr TRPAREN TSEMI
 				{
-					std::cout << "set color function\n";
-					$$ = new NSetColorStmt($3);
+					PARSER_TRACE("set color function\n");
+					$$ = ctx.ast.AddUnary(NodeKind::SetColorStmt, $3);
 				}
 			| TFWD TLPAREN expr TRPAREN TSEMI
 				{
-					std::cout << "forward function\n";
-					$$ = new NFwdStmt($3);
+					PARSER_TRACE("forward function\n");
+					$$ = ctx.ast.AddUnary(NodeKind::FwdStmt, $3);
 				}
 			| TBACK TLPAREN expr TRPAREN TSEMI
 				{
-					std::cout << "back function\n";
-					$$ = new NBackStmt($3);
+					PARSER_TRACE("back function\n");
+					$$ = ctx.ast.AddUnary(NodeKind::BackStmt, $3);
 				}
 			| TROT TLPAREN expr TRPAREN TSEMI
 				{
-					std::cout << "rotate function\n";
-					$$ = new NRotStmt($3);
+					PARSER_TRACE("rotate function\n");
+					$$ = ctx.ast.AddUnary(NodeKind::RotStmt, $3);
 				}
 ;
 
 block		: statement
 				{
-					std::cout << "single block\n";
-					$$ = new NBlock();
-					$$->AddStatement($1);
+					PARSER_TRACE("single block\n");
+					$$ = ctx.ast.BeginList();
+					ctx.ast.AddToList($1);
 				}
 			| block statement
 				{
-					std::cout << "multiple blocks\n";
-					$$->AddStatement($2);
+					PARSER_TRACE("multiple blocks\n");
+					ctx.ast.AddToList($2);
 				}
 ;
 
 expr		: numeric
 				{
-					std::cout << "Numeric expression\n";
-					$$ = new NNumericExpr($1);
+					PARSER_TRACE("Numeric expression\n");
+					$$ = ctx.ast.AddUnary(NodeKind::NumericExpr, $1);
 				}
 			| TIDENTIFIER
 				{
-					std::cout << "Identifier expression\n";
-					$$ = new NVarExpr(*$1);
+					PARSER_TRACE("Identifier expression\n");
+					$$ = ctx.ast.AddName(NodeKind::VarExpr, $1, NodeRef::None(), NodeRef::None());
 				}
 			| expr TADD expr
 				{
-					std::cout << "var plus assignment\n";
-					$$ = new NBinaryExpr($1, $2, $3);
+					PARSER_TRACE("var plus assignment\n");
+					$$ = ctx.ast.AddBinary(NodeKind::BinaryExpr, $1, $2, $3);
 				}
 			| expr TSUB expr
 				{
-					std::cout << "var minus assignment\n";
-					$$ = new NBinaryExpr($1, $2, $3);
+					PARSER_TRACE("var minus assignment\n");
+					$$ = ctx.ast.AddBinary(NodeKind::BinaryExpr, $1, $2, $3);
 
 				}
 			| expr TMUL expr
 				{
-					std::cout << "var multiply assignment\n";
-					$$ = new NBinaryExpr($1, $2, $3);
+					PARSER_TRACE("var multiply assignment\n");
+					$$ = ctx.ast.AddBinary(NodeKind::BinaryExpr, $1, $2, $3);
 
 				}
 			| expr TDIV expr
 				{
-					std::cout << "var divide assignment\n";
-					$$ = new NBinaryExpr($1, $2, $3);
+					PARSER_TRACE("var divide assignment\n");
+					$$ = ctx.ast.AddBinary(NodeKind::BinaryExpr, $1, $2, $3);
 				}
 			| TLPAREN expr TRPAREN
 				{
-					std::cout << "expresion inside parenthesis\n";
+					PARSER_TRACE("expresion inside parenthesis\n");
 					$$ = ($2);
 				}
 			| TIDENTIFIER TLBRACKET expr TRBRACKET
 				{
-					std::cout << "accessing array index\n";
-					$$ = new NArrayExpr(*$1, $3);
+					PARSER_TRACE("accessing array index\n");
+					$$ = ctx.ast.AddName(NodeKind::ArrayExpr, $1, $3, NodeRef::None());
 				}
 ;
 
 cndn		: expr TLESS expr
 				{
-					std::cout << "expression less than other expression\n";
-					$$ = new NComparison($1, $2, $3);
+					PARSER_TRACE("expression less than other expression\n");
+					$$ = ctx.ast.AddBinary(NodeKind::Comparison, $1, $2, $3);
 				}
 			| expr TISEQUAL expr
 				{
-					std::cout << "expression is equal to other expression\n";
-					$$ = new NComparison($1, $2, $3);
+					PARSER_TRACE("expression is equal to other expression\n");
+					$$ = ctx.ast.AddBinary(NodeKind::Comparison, $1, $2, $3);
 				}
 ;
 
 numeric		: TINTEGER
 				{
-					std::cout << "Numeric value of " << *($1) << '\n';
-					$$ = new NNumeric(*($1));
+					PARSER_TRACE("Numeric value of " << $1 << '\n');
+					int value = 0;
+					if (!ParseNumeric($1, value))
+					{
+						*ctx.diag << "ERROR: Integer " << $1 << " is too large on line " << ctx.lineNumber << std::endl;
+						ctx.syntaxError = true;
+					}
+					$$ = ctx.ast.AddNumeric(value);
 				}
 ;
 
@@ -1,133 +1,314 @@
 #include "Register.h"
+#include "CFG.h"
+#include "Liveness.h"
+#include "TextWriter.h"
 #include <fstream>
-#include <map>
+#include <algorithm>
 #include <utility>
 
 // Generates intervals for each virtual register
-void Register::GenerateIntervals(CodeContext& program, std::ofstream& reg) {
-
-	std::map<std::string, std::pair<int, int>> intervalMap;
-
-	// find virtual registers in program
-	for (int i = 0; i < program.opsVector.size(); i++) {
-		for (int j = 0; j < program.opsVector[i].params.size(); j++) {
-			std::string temp = program.opsVector[i].params[j];
-			// VRs are identified by the '%'
-			if (temp.find('%') != std::string::npos) {	// a VR is...
-				// not found
-				if (intervalMap.find(temp) == intervalMap.end()) {
-					intervalMap[temp] = std::make_pair(i, i);
-				}
-				//found
-				else {
-					intervalMap.at(temp).second = i;
+// one pass over the instruction stream, filling a table indexed by VR number.
+// Positions are indices in the final program, Label pseudo-ops don't count.
+// A VR that is live into or out of a block covers the block's first/last
+// position too, so an interval spans every loop the VR is live around.
+void Register::GenerateIntervals(const CodeContext& program, const CFG& cfg, const Liveness& liveness) {
+
+	mIntervals.assign(program.lastVRegIndex, Interval());
+
+	auto extend = [this](int vr, int position) {
+		Interval& interval = mIntervals[vr];
+		if (interval.start < 0 || position < interval.start) {
+			interval.start = position;
+		}
+		if (position > interval.end) {
+			interval.end = position;
+		}
+	};
+
+	int i = -1;
+	for (int b = 0; b < cfg.GetNumBlocks(); b++) {
+		const BasicBlock& block = cfg.GetBlock(b);
+		int blockStart = i + 1;
+
+		for (int index = block.first; index < block.end; index++) {
+			const Ops& ops = program.opsVector[index];
+			if (ops.op == OpCode::Label) {
+				continue;
+			}
+			i++;
+			for (int j = 0; j < ops.numParams; j++) {
+				if (ops.params[j].IsVReg()) {
+					extend(ops.params[j].value, i);
 				}
 			}
 		}
+
+		if (cfg.IsReachable(b)) {
+			liveness.ForEachLiveIn(b, [&](int vr) { extend(vr, blockStart); });
+			liveness.ForEachLiveOut(b, [&](int vr) { extend(vr, i); });
+		}
 	}
 
-	int counter = 0;
-	int max = 0;
+}
 
-	while (counter < intervalMap.size()) {
-		std::string sub = "%" + std::to_string(counter);
+// INTERVALS section of reg.txt
+// VRs that never appear in the program have no interval
+void Register::OutputIntervals(TextWriter& reg) const {
 
-		if (intervalMap.find(sub) != intervalMap.end()) {
-			reg << sub << ":" << intervalMap.at(sub).first << "," << intervalMap.at(sub).second << '\n';
-			counter++;
-			max = intervalMap.at(sub).second;
+	reg.Write("INTERVALS:\n");
+	for (int i = 0; i < static_cast<int>(mIntervals.size()); i++) {
+		if (!mIntervals[i].IsEmpty()) {
+			// "%i:start,end" formatted in place
+			char* p = reg.Reserve(3 * TextWriter::kMaxIntLength + 4);
+			*p++ = '%';
+			p = TextWriter::FormatInt(p, i);
+			*p++ = ':';
+			p = TextWriter::FormatInt(p, mIntervals[i].start);
+			*p++ = ',';
+			p = TextWriter::FormatInt(p, mIntervals[i].end);
+			*p++ = '\n';
+			reg.Commit(p);
 		}
+	}
+}
+
+// Linear Scan algorithm - creates the mapping from virtual registers to real registers
+// If all seven registers cannot hold every interval, the scan is redone with
+// r6/r7 held back as scratch registers for the reload/spill code
+void Register::LinearScan(CodeContext& program) {
+
+	int count = static_cast<int>(mIntervals.size());
 
+	if (!Scan(kNumRegisters)) {
+		Scan(kNumRegisters - kNumScratch);
 	}
 
-	// run Linear scan algorithm
-	LinearScan(program, reg, intervalMap, max);
+	// spilled VRs get stack slots after the variables/arrays
+	int numSpills = 0;
+	for (int i = 0; i < count; i++) {
+		if (mSpillSlot[i] >= 0) {
+			mSpillSlot[i] = program.lastStackIndex + numSpills;
+			numSpills++;
+		}
+	}
 
-}
+	if (numSpills > 0) {
+		InsertSpillCode(program, numSpills);
+	}
+	mNumSpills = numSpills;
 
-// Linear Scan algorithm - creates the mapping from virtual registers to real registers
-void Register::LinearScan(CodeContext& program, std::ofstream& reg, std::map<std::string, std::pair<int, int>> map, int max) {
+}
 
-	reg << "ALLOCATION:" << '\n';
-	std::map<std::string, std::string> middle;
-	std::map<std::string, bool> real;
+// ALLOCATION section of reg.txt, plus the SPILLS section if anything spilled
+void Register::OutputAllocation(TextWriter& reg) const {
 
-	// prepopulate middle map
-	for (int i = 0; i < map.size(); i++) {
-		std::string count = "%" + std::to_string(i);
-		middle[count] = "";
+	reg.Write("ALLOCATION:\n");
+	int count = static_cast<int>(mIntervals.size());
+	for (int i = 0; i < count; i++) {
+		if (mIntervals[i].IsEmpty()) {
+			continue;
+		}
+		if (mSpillSlot[i] >= 0) {
+			reg.Write('%');
+			reg.WriteInt(i);
+			reg.Write(":spill\n");
+		}
+		else {
+			reg.Write('%');
+			reg.WriteInt(i);
+			reg.Write(":r");
+			reg.WriteInt(mAssignment[i]);
+			reg.Write('\n');
+		}
 	}
 
-	// prepopulate real map
-	for (int i = 1; i < 8; i++) {
-		std::string count = "r" + std::to_string(i);
-		real[count] = true;
+	if (mNumSpills > 0) {
+		reg.Write("SPILLS:\n");
+		for (int i = 0; i < count; i++) {
+			if (mSpillSlot[i] >= 0) {
+				reg.Write('%');
+				reg.WriteInt(i);
+				reg.Write(':');
+				reg.WriteInt(mSpillSlot[i]);
+				reg.Write('\n');
+			}
+		}
 	}
-	// do scanning
+}
 
-	int mainloop = 0;
-	int step;
-	int check = 0;
-	std::map<std::string, int> noCome;
-	while (mainloop < map.size()) {	// iterate over interval map
+// One pass of Poletto & Sarkar linear scan over the first numRegisters registers:
+// intervals are visited by increasing start point, the active list is kept sorted
+// by end point and free registers are tracked in a bitset. When every register is
+// busy, whichever of the active intervals and the new one ends last is spilled.
+// Returns false if anything was spilled.
+bool Register::Scan(int numRegisters) {
 
-		int k = max;
+	int count = static_cast<int>(mIntervals.size());
+	mAssignment.assign(count, 0);
+	mSpillSlot.assign(count, -1);
+	bool noSpills = true;
 
-		std::string mainsub = "%" + std::to_string(mainloop);
+	// intervals in order of increasing start point
+	std::vector<int> order;
+	order.reserve(count);
+	for (int i = 0; i < count; i++) {
+		if (!mIntervals[i].IsEmpty()) {
+			order.emplace_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [this](int a, int b) {
+		return mIntervals[a].start < mIntervals[b].start
+			|| (mIntervals[a].start == mIntervals[b].start && a < b);
+	});
 
-		// check intervals
-		if (map.find(mainsub) != map.end()) {
-			// get where address first appears
-			step = map.at(mainsub).first;
+	// active intervals sorted by increasing end point
+	int active[kNumRegisters];
+	int numActive = 0;
+	// bit i set = register r(i + 1) is free
+	unsigned freeRegs = (1u << numRegisters) - 1;
 
-			for (int i = 0; i < map.size(); i++) {
-				for (int i = 0; i < max; i++) {
-					std::string t = "%" + std::to_string(i);
-					if (map.at(t).second == step || map.at(t).second < step) {	// expires
+	for (int vr : order) {
+		const Interval& current = mIntervals[vr];
 
-						std::string bye = middle.at(t);
-						real.at(bye) = true;
-					}
-				}
+		// expire intervals that end at or before this one starts
+		int expired = 0;
+		while (expired < numActive && mIntervals[active[expired]].end <= current.start) {
+			freeRegs |= 1u << (mAssignment[active[expired]] - 1);
+			expired++;
+		}
+		if (expired > 0) {
+			std::copy(active + expired, active + numActive, active);
+			numActive -= expired;
+		}
 
-				// VECTOR OF PAIRS JUST PUT A '%' BEFORE EVERY i WHEN WRITING
-				// TO FILE. DONE. EASY
-				// check if VR is already in list, if so, just incremement and 
-				// continue, otherwise do the freeing and then add VR to list and 
-				// increment
+		if (freeRegs == 0) {
+			noSpills = false;
+			int last = active[numActive - 1];
+			if (mIntervals[last].end <= current.end) {
+				// the new interval lives the longest, it goes to memory
+				mSpillSlot[vr] = 0;
+				continue;
 			}
-				int realloop = 1;
-				while (realloop < real.size() + 1) {
-					std::string realsub = "r" + std::to_string(realloop);
-					if ((real.find(realsub) != real.end())) {
-						if (real.at(realsub)) {
-							//register available
-							middle[mainsub] = realsub;
-							real.at(realsub) = false;
-							realloop = real.size() + 1;
-						}
-					}
-					realloop++;
-				}
+			// otherwise it takes the register of the longest active interval
+			freeRegs |= 1u << (mAssignment[last] - 1);
+			mAssignment[last] = 0;
+			mSpillSlot[last] = 0;
+			numActive--;
+		}
+
+		// take the lowest numbered free register
+		int bit = 0;
+		while (((freeRegs >> bit) & 1u) == 0) {
+			bit++;
 		}
-		mainloop++;
-		//step++;
+		freeRegs &= ~(1u << bit);
+		mAssignment[vr] = bit + 1;
 
+		// insert into the active list, keeping it sorted by end point
+		int pos = numActive;
+		while (pos > 0 && mIntervals[active[pos - 1]].end > current.end) {
+			active[pos] = active[pos - 1];
+			pos--;
+		}
+		active[pos] = vr;
+		numActive++;
 	}
 
+	return noSpills;
+}
 
+// Rewrites every reference to a spilled VR to go through a scratch register:
+// a loadi from its slot before each read and a storei after each write.
+// The slots themselves are pushed right after the data section.
+void Register::InsertSpillCode(CodeContext& program, int numSpills) {
 
+	const int firstScratch = kNumRegisters - kNumScratch + 1;
+	int size = static_cast<int>(program.opsVector.size());
 
-		// output reg
-		int counter = 0;
-		while (counter < middle.size()) {
-			std::string sub = "%" + std::to_string(counter);
+	// branch targets are labels, they move with the instructions by themselves
+	std::vector<Ops> result;
+	result.reserve(size + numSpills);
 
-			if (middle.find(sub) != middle.end()) {
-				reg << sub << ":" << middle.at(sub) << '\n';
-				counter++;
+	// the data section is the first lastStackIndex pushes
+	int numPushes = 0;
+	bool slotsPushed = false;
+	for (int i = 0; i < size; i++) {
+		if (!slotsPushed && numPushes == program.lastStackIndex) {
+			for (int j = 0; j < numSpills; j++) {
+				result.emplace_back(Ops(OpCode::Push, Operand::PhysReg(0)));
 			}
+			slotsPushed = true;
+		}
+		if (program.opsVector[i].op == OpCode::Push) {
+			numPushes++;
 		}
 
+		Ops ops = program.opsVector[i];
+		int scratch[Ops::kMaxParams] = { 0, 0, 0 };
+		int nextScratch = firstScratch;
 
+		// reads first, each distinct spilled VR gets its own scratch register
+		for (int j = 0; j < ops.numParams; j++) {
+			const Operand& param = ops.params[j];
+			if (!param.IsVReg() || mSpillSlot[param.value] < 0 || !IsUse(ops, j)) {
+				continue;
+			}
+			for (int k = 0; k < j; k++) {
+				if (scratch[k] != 0 && ops.params[k].value == param.value) {
+					scratch[j] = scratch[k];
+				}
+			}
+			if (scratch[j] == 0) {
+				scratch[j] = nextScratch++;
+				result.emplace_back(Ops(OpCode::Loadi, Operand::PhysReg(scratch[j]), Operand::Stack(mSpillSlot[param.value])));
+			}
+		}
+
+		// writes happen after the reads, so they can reuse the first scratch register
+		for (int j = 0; j < ops.numParams; j++) {
+			const Operand& param = ops.params[j];
+			if (param.IsVReg() && mSpillSlot[param.value] >= 0 && scratch[j] == 0) {
+				scratch[j] = firstScratch;
+			}
+		}
+
+		Ops rewritten = ops;
+		for (int j = 0; j < ops.numParams; j++) {
+			if (scratch[j] != 0) {
+				rewritten.params[j] = Operand::PhysReg(scratch[j]);
+			}
+		}
+		result.emplace_back(rewritten);
+
+		for (int j = 0; j < ops.numParams; j++) {
+			if (scratch[j] != 0 && IsDef(ops, j)) {
+				result.emplace_back(Ops(OpCode::Storei, Operand::Stack(mSpillSlot[ops.params[j].value]), Operand::PhysReg(scratch[j])));
+			}
+		}
+	}
+	program.opsVector.swap(result);
+	program.lastStackIndex += numSpills;
+}
+
+// Applies the VR -> rN mapping to the instruction stream in place
+// (spilled VRs were already replaced by scratch registers in InsertSpillCode)
+void Register::Rewrite(CodeContext& program) const {
+
+	size_t kept = 0;
+	for (auto& ops : program.opsVector) {
+		for (int j = 0; j < ops.numParams; j++) {
+			Operand& param = ops.params[j];
+			if (param.IsVReg()) {
+				param = Operand::PhysReg(mAssignment[param.value]);
+			}
+		}
+
+		// a copy between two VRs that got the same register does nothing
+		if (ops.op == OpCode::Mov && ops.params[0].kind == OperandKind::PhysReg
+			&& ops.params[1].kind == OperandKind::PhysReg && ops.params[0].value == ops.params[1].value) {
+			continue;
+		}
+		program.opsVector[kept++] = ops;
+	}
+	program.opsVector.erase(program.opsVector.begin() + kept, program.opsVector.end());
 }
@@ -3,16 +3,55 @@
 #include <iostream>
 #include "Node.h"
 #include <fstream>
+#include <vector>
+
+class CFG;
+class Liveness;
+
+// Live interval of one virtual register, in instruction indices
+struct Interval
+{
+	// first and last instruction that mentions the register
+	int start = -1;
+	int end = -1;
+
+	bool IsEmpty() const { return start < 0; }
+};
 
 // Defines Register class
 class Register {
 public:
+	// real registers r1 - r7 are available to the allocator
+	static const int kNumRegisters = 7;
+	// how many of them are held back for reload/spill code once anything spills
+	static const int kNumScratch = 2;
+
 	Register() = default;
 
-	void GenerateIntervals(CodeContext& program, std::ofstream& reg);
+	// builds the live interval of every VR
+	void GenerateIntervals(const CodeContext& program, const CFG& cfg, const Liveness& liveness);
 
-	void LinearScan(CodeContext& program, std::ofstream& reg, std::map<std::string, std::pair<int, int>> map, int max);
+	// assigns real registers, inserting spill code into the program if needed
+	void LinearScan(CodeContext& program);
+
+	// replaces every VR in the program with its real register, dropping
+	// the copies that end up from a register to itself
+	void Rewrite(CodeContext& program) const;
+
+	// reg.txt sections
+	void OutputIntervals(TextWriter& reg) const;
+	void OutputAllocation(TextWriter& reg) const;
 
 private:
-	std::pair<std::string, std::string> realRegisters;
+	bool Scan(int numRegisters);
+
+	void InsertSpillCode(CodeContext& program, int numSpills);
+
+	// intervals indexed by virtual register number
+	std::vector<Interval> mIntervals;
+	// allocation result indexed by virtual register number: the real
+	// register (0 if none) and the stack slot (-1 if in a register)
+	std::vector<int> mAssignment;
+	std::vector<int> mSpillSlot;
+	int mNumSpills = 0;
 };
@@ -0,0 +1,44 @@
+#pragma once
+#include <ostream>
+#include <vector>
+#include "SymbolTable.h"
+
+// ResolveContext
+// state of the name resolution pass, which runs between parsing and codegen:
+// declarations in data get their stack slots, in the same order codegen pushes
+// them, and every use of a name is bound to its slot so codegen never has to
+// look a name up. Undeclared and duplicate names, and a var used as an array
+// or an array without a subscript, are reported to diag.
+struct ResolveContext
+{
+	ResolveContext(const SymbolTable& symbolTable, std::ostream& diagStream)
+		:symbols(symbolTable)
+		,diag(diagStream)
+		,slots(symbolTable.GetNumSymbols(), kUndeclared)
+		,arrays(symbolTable.GetNumSymbols(), false)
+	{ }
+
+	// gives symbol the next size stack slots, returns the first one
+	int Declare(int symbol, int size, bool array);
+
+	// slot of a declared symbol; reports an undeclared one (once per name)
+	// and one used with a subscript if it's a var or without one if it's
+	// an array
+	int Lookup(int symbol, bool subscripted);
+
+	static const int kUndeclared = -1;
+	static const int kReported = -2;
+
+	const SymbolTable& symbols;
+	std::ostream& diag;
+
+	// stack slot of each symbol by id, or kUndeclared/kReported
+	std::vector<int> slots;
+	// whether each symbol was (last) declared as an array
+	std::vector<bool> arrays;
+
+	// number of stack slots declared so far
+	int lastStackIndex = 0;
+
+	int numErrors = 0;
+};
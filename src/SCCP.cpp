@@ -0,0 +1,744 @@
+#include "SCCP.h"
+#include "CFG.h"
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+// Wegman & Zadeck's algorithm with two worklists: a block is evaluated in
+// full once, when it first becomes executable; after that an op is evaluated
+// again only when a value it reads changes, and a block's phis when another
+// of its incoming edges becomes executable. The lattice only goes down
+// (unknown -> constant -> varying), so every op is evaluated a bounded
+// number of times.
+
+namespace
+{
+	enum class State : uint8_t
+	{
+		Unknown,
+		Constant,
+		Varying,
+	};
+
+	struct Value
+	{
+		State state;
+		int32_t constant;
+
+		static Value Unknown() { return Value{ State::Unknown, 0 }; }
+		static Value Constant(int32_t k) { return Value{ State::Constant, k }; }
+		static Value Varying() { return Value{ State::Varying, 0 }; }
+
+		bool IsConstant() const { return state == State::Constant; }
+	};
+
+	Value Meet(Value a, Value b)
+	{
+		if (a.state == State::Unknown)
+		{
+			return b;
+		}
+		if (b.state == State::Unknown)
+		{
+			return a;
+		}
+		if (a.IsConstant() && b.IsConstant() && a.constant == b.constant)
+		{
+			return a;
+		}
+		return Value::Varying();
+	}
+
+	// a op b with the registers' wrap-around; varying if it would trap
+	Value Fold(OpCode op, Value a, Value b)
+	{
+		if (a.state == State::Varying || b.state == State::Varying)
+		{
+			return Value::Varying();
+		}
+		if (a.state == State::Unknown || b.state == State::Unknown)
+		{
+			return Value::Unknown();
+		}
+
+		uint32_t x = static_cast<uint32_t>(a.constant);
+		uint32_t y = static_cast<uint32_t>(b.constant);
+		switch (op)
+		{
+		case OpCode::Add:
+			return Value::Constant(static_cast<int32_t>(x + y));
+		case OpCode::Sub:
+			return Value::Constant(static_cast<int32_t>(x - y));
+		case OpCode::Mul:
+			return Value::Constant(static_cast<int32_t>(x * y));
+		case OpCode::Div:
+			if (b.constant == 0 || (a.constant == INT_MIN && b.constant == -1))
+			{
+				return Value::Varying();
+			}
+			return Value::Constant(a.constant / b.constant);
+		case OpCode::Cmpeq:
+			return Value::Constant(a.constant == b.constant);
+		case OpCode::Cmplt:
+			return Value::Constant(a.constant < b.constant);
+		default:
+			return Value::Varying();
+		}
+	}
+
+	class ConstantPropagation
+	{
+	public:
+		ConstantPropagation(CodeContext& program, const CFG& cfg)
+			:mProgram(program)
+			,mCfg(cfg)
+		{ }
+
+		bool Run();
+
+	private:
+		void FindDefsAndUses();
+		void Solve();
+		void VisitBlock(int b);
+		void VisitOp(int i);
+		void VisitBranch(int b, Value flag);
+		bool Rewrite();
+		bool RewriteBlock(int b, std::vector<bool>& removed);
+		bool RemoveJumpsToNext(std::vector<bool>& removed);
+		void RemoveChain(int b, int index, std::vector<bool>& removed);
+
+		// value operand j of op i reads: that of the def reaching it
+		Value Get(int i, int j) const
+		{
+			if (!mProgram.opsVector[i].params[j].IsVReg())
+			{
+				return Value::Varying();
+			}
+			int def = mReads[i * Ops::kMaxParams + j];
+			return def >= 0 ? mValues[def] : Value::Unknown();
+		}
+
+		// value of a VR after its last def
+		Value GetFinal(int vreg) const
+		{
+			int def = mLastDef[vreg];
+			return def >= 0 ? mValues[def] : Value::Unknown();
+		}
+
+		void Define(int i, Value value);
+		void MarkEdge(int b, int succ);
+		void Enqueue(int b);
+		void EnqueueOp(int i);
+
+		bool IsEdgeExecutable(int from, int to) const;
+
+		CodeContext& mProgram;
+		const CFG& mCfg;
+
+		// value each op defines, by op index
+		std::vector<Value> mValues;
+		// op index of the last def of each VR; a VR only has several defs
+		// when inc/dec changes it in place, always within one block
+		std::vector<int> mLastDef;
+		// per op and operand, the op whose def the operand reads: an
+		// earlier one in the same block, otherwise the VR's last def
+		std::vector<int> mReads;
+		// ops reading each op's def (including through phi arguments),
+		// those of op i at mUsers[mUserStart[i]] up to mUserStart[i + 1]
+		std::vector<int> mUserStart;
+		std::vector<int> mUsers;
+		std::vector<int> mBlockOf;
+		// per block, the compare its closing jnt reads, or -1 if it doesn't
+		// end in a jnt after a compare
+		std::vector<int> mFlagOp;
+
+		std::vector<bool> mExecutable;
+		// per block, one flag for each entry of its succs
+		std::vector<std::vector<bool>> mEdges;
+		std::vector<int> mWork;
+		std::vector<bool> mQueued;
+		std::vector<int> mOpWork;
+		std::vector<bool> mOpQueued;
+	};
+
+	bool ConstantPropagation::Run()
+	{
+		FindDefsAndUses();
+		Solve();
+		return Rewrite();
+	}
+
+	void ConstantPropagation::FindDefsAndUses()
+	{
+		int numOps = static_cast<int>(mProgram.opsVector.size());
+		int numBlocks = mCfg.GetNumBlocks();
+		mValues.assign(numOps, Value::Unknown());
+		mLastDef.assign(mProgram.lastVRegIndex, -1);
+		mReads.assign(numOps * Ops::kMaxParams, -1);
+		mUserStart.assign(numOps + 1, 0);
+		mBlockOf.assign(numOps, -1);
+		mFlagOp.assign(numBlocks, -1);
+
+		for (int b = 0; b < numBlocks; b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			int compare = -1;
+			for (int i = block.first; i < block.end; i++)
+			{
+				const Ops& ops = mProgram.opsVector[i];
+				mBlockOf[i] = b;
+				if (ops.op == OpCode::Cmpeq || ops.op == OpCode::Cmplt)
+				{
+					compare = i;
+				}
+				if (ops.numParams > 0 && IsDef(ops, 0) && ops.params[0].IsVReg())
+				{
+					mLastDef[ops.params[0].value] = i;
+				}
+			}
+			if (block.end > block.first && mProgram.opsVector[block.end - 1].op == OpCode::Jnt
+				&& block.succs.size() == 2)
+			{
+				mFlagOp[b] = compare;
+			}
+		}
+
+		// the defs each op reads, counted per def and then listed
+		std::vector<int> localDef(mProgram.lastVRegIndex, -1);
+		std::vector<int> localStamp(mProgram.lastVRegIndex, -1);
+		for (int b = 0; b < numBlocks; b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			for (int i = block.first; i < block.end; i++)
+			{
+				const Ops& ops = mProgram.opsVector[i];
+				if (ops.op == OpCode::Phi)
+				{
+					for (const PhiArg& arg : mProgram.phis[ops.params[1].value].args)
+					{
+						if (arg.value.IsVReg() && mLastDef[arg.value.value] >= 0)
+						{
+							mUserStart[mLastDef[arg.value.value] + 1]++;
+						}
+					}
+				}
+				for (int j = 0; j < ops.numParams; j++)
+				{
+					int vreg = ops.params[j].value;
+					if (!ops.params[j].IsVReg() || !IsUse(ops, j))
+					{
+						continue;
+					}
+					int def = localStamp[vreg] == b ? localDef[vreg] : mLastDef[vreg];
+					mReads[i * Ops::kMaxParams + j] = def;
+					if (def >= 0)
+					{
+						mUserStart[def + 1]++;
+					}
+				}
+				if (ops.numParams > 0 && IsDef(ops, 0) && ops.params[0].IsVReg())
+				{
+					localDef[ops.params[0].value] = i;
+					localStamp[ops.params[0].value] = b;
+				}
+			}
+		}
+
+		for (int i = 0; i < numOps; i++)
+		{
+			mUserStart[i + 1] += mUserStart[i];
+		}
+		mUsers.resize(mUserStart[numOps]);
+		std::vector<int> next(mUserStart.begin(), mUserStart.end() - 1);
+		for (int i = 0; i < numOps; i++)
+		{
+			const Ops& ops = mProgram.opsVector[i];
+			if (ops.op == OpCode::Phi && mBlockOf[i] >= 0)
+			{
+				for (const PhiArg& arg : mProgram.phis[ops.params[1].value].args)
+				{
+					if (arg.value.IsVReg() && mLastDef[arg.value.value] >= 0)
+					{
+						mUsers[next[mLastDef[arg.value.value]]++] = i;
+					}
+				}
+			}
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				int def = mReads[i * Ops::kMaxParams + j];
+				if (def >= 0)
+				{
+					mUsers[next[def]++] = i;
+				}
+			}
+		}
+	}
+
+	void ConstantPropagation::Solve()
+	{
+		int numBlocks = mCfg.GetNumBlocks();
+		mExecutable.assign(numBlocks, false);
+		mQueued.assign(numBlocks, false);
+		mOpQueued.assign(mProgram.opsVector.size(), false);
+		mEdges.resize(numBlocks);
+		for (int b = 0; b < numBlocks; b++)
+		{
+			mEdges[b].assign(mCfg.GetBlock(b).succs.size(), false);
+		}
+
+		if (numBlocks > 0)
+		{
+			Enqueue(0);
+		}
+		while (!mWork.empty() || !mOpWork.empty())
+		{
+			if (!mWork.empty())
+			{
+				int b = mWork.back();
+				mWork.pop_back();
+				mQueued[b] = false;
+				mExecutable[b] = true;
+				VisitBlock(b);
+				continue;
+			}
+			int i = mOpWork.back();
+			mOpWork.pop_back();
+			mOpQueued[i] = false;
+			VisitOp(i);
+		}
+	}
+
+	void ConstantPropagation::Enqueue(int b)
+	{
+		if (!mQueued[b])
+		{
+			mQueued[b] = true;
+			mWork.emplace_back(b);
+		}
+	}
+
+	void ConstantPropagation::EnqueueOp(int i)
+	{
+		if (!mOpQueued[i])
+		{
+			mOpQueued[i] = true;
+			mOpWork.emplace_back(i);
+		}
+	}
+
+	// a block already evaluated only needs its phis again for a new edge
+	void ConstantPropagation::MarkEdge(int b, int succ)
+	{
+		if (mEdges[b][succ])
+		{
+			return;
+		}
+		mEdges[b][succ] = true;
+		int to = mCfg.GetBlock(b).succs[succ];
+		if (!mExecutable[to])
+		{
+			Enqueue(to);
+			return;
+		}
+		const BasicBlock& block = mCfg.GetBlock(to);
+		for (int i = block.first; i < block.end; i++)
+		{
+			OpCode op = mProgram.opsVector[i].op;
+			if (op == OpCode::Phi)
+			{
+				EnqueueOp(i);
+			}
+			else if (op != OpCode::Label)
+			{
+				break;
+			}
+		}
+	}
+
+	bool ConstantPropagation::IsEdgeExecutable(int from, int to) const
+	{
+		const std::vector<int>& succs = mCfg.GetBlock(from).succs;
+		for (size_t s = 0; s < succs.size(); s++)
+		{
+			if (succs[s] == to && mEdges[from][s])
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ConstantPropagation::Define(int i, Value value)
+	{
+		Value lowered = Meet(mValues[i], value);
+		if (lowered.state == mValues[i].state && lowered.constant == mValues[i].constant)
+		{
+			return;
+		}
+		mValues[i] = lowered;
+		for (int u = mUserStart[i]; u < mUserStart[i + 1]; u++)
+		{
+			if (mExecutable[mBlockOf[mUsers[u]]])
+			{
+				EnqueueOp(mUsers[u]);
+			}
+		}
+	}
+
+	void ConstantPropagation::VisitBlock(int b)
+	{
+		const BasicBlock& block = mCfg.GetBlock(b);
+		for (int i = block.first; i < block.end; i++)
+		{
+			VisitOp(i);
+		}
+		if (mFlagOp[b] < 0)
+		{
+			VisitBranch(b, Value::Varying());
+		}
+	}
+
+	void ConstantPropagation::VisitOp(int i)
+	{
+		const Ops& ops = mProgram.opsVector[i];
+		switch (ops.op)
+		{
+		case OpCode::Phi:
+		{
+			int b = mBlockOf[i];
+			Value value = Value::Unknown();
+			for (const PhiArg& arg : mProgram.phis[ops.params[1].value].args)
+			{
+				int pred = mCfg.GetLabelBlock(arg.pred);
+				if (pred >= 0 && IsEdgeExecutable(pred, b))
+				{
+					value = Meet(value, arg.value.IsVReg() ? GetFinal(arg.value.value) : Value::Varying());
+				}
+			}
+			Define(i, value);
+			break;
+		}
+		case OpCode::Movi:
+			Define(i, ops.params[1].kind == OperandKind::Imm
+				? Value::Constant(ops.params[1].value) : Value::Varying());
+			break;
+		case OpCode::Mov:
+			Define(i, Get(i, 1));
+			break;
+		case OpCode::Add:
+		case OpCode::Sub:
+		case OpCode::Mul:
+		case OpCode::Div:
+			Define(i, Fold(ops.op, Get(i, 1), Get(i, 2)));
+			break;
+		case OpCode::Inc:
+			Define(i, Fold(OpCode::Add, Get(i, 0), Value::Constant(1)));
+			break;
+		case OpCode::Dec:
+			Define(i, Fold(OpCode::Sub, Get(i, 0), Value::Constant(1)));
+			break;
+		case OpCode::Cmpeq:
+		case OpCode::Cmplt:
+			if (mFlagOp[mBlockOf[i]] == i)
+			{
+				VisitBranch(mBlockOf[i], Fold(ops.op, Get(i, 0), Get(i, 1)));
+			}
+			break;
+		default:
+			if (ops.numParams > 0 && IsDef(ops, 0))
+			{
+				Define(i, Value::Varying());
+			}
+			break;
+		}
+	}
+
+	// jnt falls through when the comparison held and jumps when it didn't
+	void ConstantPropagation::VisitBranch(int b, Value flag)
+	{
+		const BasicBlock& block = mCfg.GetBlock(b);
+		int numSuccs = static_cast<int>(block.succs.size());
+		OpCode last = mProgram.opsVector[block.end - 1].op;
+		if (last != OpCode::Jnt || numSuccs != 2 || flag.state == State::Varying)
+		{
+			for (int s = 0; s < numSuccs; s++)
+			{
+				MarkEdge(b, s);
+			}
+			return;
+		}
+		if (flag.IsConstant())
+		{
+			MarkEdge(b, flag.constant != 0 ? 0 : 1);
+		}
+	}
+
+	bool ConstantPropagation::Rewrite()
+	{
+		// a jnt reads the flag of the last compare, which CodeGen always
+		// puts in the same block; only then can a compare go with its jnt
+		bool flagsLocal = true;
+		for (int b = 0; b < mCfg.GetNumBlocks() && flagsLocal; b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			bool compared = false;
+			for (int i = block.first; i < block.end; i++)
+			{
+				OpCode op = mProgram.opsVector[i].op;
+				compared |= op == OpCode::Cmpeq || op == OpCode::Cmplt;
+				if (op == OpCode::Jnt && !compared)
+				{
+					flagsLocal = false;
+				}
+			}
+		}
+
+		std::vector<bool> removed(mProgram.opsVector.size(), false);
+		bool changed = false;
+		for (int b = 0; b < mCfg.GetNumBlocks(); b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			if (!mExecutable[b])
+			{
+				for (int i = block.first; i < block.end; i++)
+				{
+					if (mProgram.opsVector[i].op != OpCode::Label)
+					{
+						removed[i] = true;
+						changed = true;
+					}
+				}
+				continue;
+			}
+
+			changed |= RewriteBlock(b, removed);
+
+			// a branch that always goes the same way
+			const Ops& last = mProgram.opsVector[block.end - 1];
+			if (last.op != OpCode::Jnt || block.succs.size() != 2 || mEdges[b][0] == mEdges[b][1])
+			{
+				continue;
+			}
+			if (mEdges[b][0])
+			{
+				// the movi of its target too if it fed only this jnt, so
+				// the label can go once nothing can jump to it
+				removed[block.end - 1] = true;
+				int def = last.params[0].IsVReg() ? mLastDef[last.params[0].value] : -1;
+				if (def >= 0 && mProgram.opsVector[def].op == OpCode::Movi
+					&& mUserStart[def + 1] - mUserStart[def] == 1)
+				{
+					removed[def] = true;
+				}
+			}
+			else
+			{
+				mProgram.opsVector[block.end - 1].op = OpCode::Jmp;
+			}
+			changed = true;
+			for (int i = block.end - 2; i >= block.first && flagsLocal; i--)
+			{
+				OpCode op = mProgram.opsVector[i].op;
+				if (op == OpCode::Cmpeq || op == OpCode::Cmplt)
+				{
+					removed[i] = true;
+					break;
+				}
+			}
+		}
+		changed |= RemoveJumpsToNext(removed);
+
+		if (changed)
+		{
+			size_t kept = 0;
+			for (size_t i = 0; i < removed.size(); i++)
+			{
+				if (!removed[i])
+				{
+					mProgram.opsVector[kept++] = mProgram.opsVector[i];
+				}
+			}
+			mProgram.opsVector.erase(mProgram.opsVector.begin() + kept, mProgram.opsVector.end());
+		}
+		return changed;
+	}
+
+	// A jmp over blocks that can't run (the else of an if whose condition
+	// always holds, say) goes to the next instruction left. It is removed
+	// along with the labels in between, unless something that is left can
+	// still jump to one of them; the movi of its target is left to dce.
+	bool ConstantPropagation::RemoveJumpsToNext(std::vector<bool>& removed)
+	{
+		std::vector<int> labelUses(mProgram.lastLabelIndex, 0);
+		for (size_t i = 0; i < removed.size(); i++)
+		{
+			const Ops& ops = mProgram.opsVector[i];
+			if (removed[i] || ops.op == OpCode::Label)
+			{
+				continue;
+			}
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				if (ops.params[j].kind == OperandKind::Label)
+				{
+					labelUses[ops.params[j].value]++;
+				}
+			}
+		}
+
+		bool changed = false;
+		for (int b = 0; b < mCfg.GetNumBlocks(); b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			if (!mExecutable[b] || mProgram.opsVector[block.end - 1].op != OpCode::Jmp || removed[block.end - 1])
+			{
+				continue;
+			}
+			// the one edge taken; a jnt that always jumps has become a jmp
+			int to = -1;
+			for (size_t s = 0; s < block.succs.size(); s++)
+			{
+				if (mEdges[b][s])
+				{
+					to = block.succs[s];
+				}
+			}
+			bool skipped = to > b;
+			for (int between = b + 1; between < to && skipped; between++)
+			{
+				const BasicBlock& other = mCfg.GetBlock(between);
+				skipped = !mExecutable[between];
+				for (int i = other.first; i < other.end && skipped; i++)
+				{
+					const Ops& ops = mProgram.opsVector[i];
+					skipped = removed[i] || (ops.op == OpCode::Label && labelUses[ops.params[0].value] == 0);
+				}
+			}
+			if (!skipped)
+			{
+				continue;
+			}
+
+			removed[block.end - 1] = true;
+			for (int i = mCfg.GetBlock(b + 1).first; i < mCfg.GetBlock(to).first; i++)
+			{
+				removed[i] = true;
+			}
+			changed = true;
+		}
+		return changed;
+	}
+
+	bool ConstantPropagation::RewriteBlock(int b, std::vector<bool>& removed)
+	{
+		const BasicBlock& block = mCfg.GetBlock(b);
+		bool changed = false;
+		for (int i = block.first; i < block.end; i++)
+		{
+			Ops& ops = mProgram.opsVector[i];
+			if (ops.op == OpCode::Phi)
+			{
+				// only the edges that can be taken still bring a value
+				std::vector<PhiArg>& args = mProgram.phis[ops.params[1].value].args;
+				size_t kept = 0;
+				for (const PhiArg& arg : args)
+				{
+					int pred = mCfg.GetLabelBlock(arg.pred);
+					if (pred >= 0 && IsEdgeExecutable(pred, b))
+					{
+						args[kept++] = arg;
+					}
+				}
+				changed |= kept != args.size();
+				args.resize(kept);
+				if (args.size() == 1 && !GetFinal(ops.params[0].value).IsConstant())
+				{
+					ops = Ops(OpCode::Mov, ops.params[0], args[0].value);
+					changed = true;
+				}
+			}
+
+			switch (ops.op)
+			{
+			case OpCode::Phi:
+			case OpCode::Mov:
+			case OpCode::Add:
+			case OpCode::Sub:
+			case OpCode::Mul:
+			case OpCode::Div:
+			case OpCode::Inc:
+			case OpCode::Dec:
+				break;
+			default:
+				continue;
+			}
+			Operand dst = ops.params[0];
+			if (!dst.IsVReg() || mLastDef[dst.value] != i || !mValues[i].IsConstant())
+			{
+				continue;
+			}
+			bool inPlace = ops.op == OpCode::Inc || ops.op == OpCode::Dec;
+			ops = Ops(OpCode::Movi, dst, Operand::Imm(mValues[i].constant));
+			if (inPlace)
+			{
+				RemoveChain(b, i, removed);
+			}
+			changed = true;
+		}
+		return changed;
+	}
+
+	// The movi at index replaced the last inc/dec of a VR changed in place;
+	// the copy and inc/decs before it only fed that one, unless something
+	// else reads the VR in between
+	void ConstantPropagation::RemoveChain(int b, int index, std::vector<bool>& removed)
+	{
+		int vreg = mProgram.opsVector[index].params[0].value;
+		int first = mCfg.GetBlock(b).first;
+		for (int i = index - 1; i >= first; i--)
+		{
+			const Ops& ops = mProgram.opsVector[i];
+			bool uses = false;
+			bool defs = false;
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				if (ops.params[j].IsVReg() && ops.params[j].value == vreg)
+				{
+					uses |= IsUse(ops, j);
+					defs |= IsDef(ops, j);
+				}
+			}
+			if (!defs)
+			{
+				if (uses)
+				{
+					return;
+				}
+				continue;
+			}
+			if (!uses)
+			{
+				// the def that started the chain: everything up to index goes
+				for (int k = i; k < index; k++)
+				{
+					const Ops& chain = mProgram.opsVector[k];
+					if (chain.numParams > 0 && chain.params[0].IsVReg() && chain.params[0].value == vreg)
+					{
+						removed[k] = true;
+					}
+				}
+				return;
+			}
+			if (ops.op != OpCode::Inc && ops.op != OpCode::Dec)
+			{
+				return;
+			}
+		}
+	}
+}
+
+bool PropagateConstants(CodeContext& program, const CFG& cfg)
+{
+	ConstantPropagation sccp(program, cfg);
+	return sccp.Run();
+}
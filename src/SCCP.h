@@ -0,0 +1,25 @@
+#pragma once
+#include "IR.h"
+
+class CFG;
+
+// Sparse conditional constant propagation
+// Works on the program in SSA form (see SSA.h), where a variable read is the
+// value last stored to its slot, so constants flow through the stack slots
+// and phis. Every VR starts out unknown and is lowered to a constant or to
+// "varying" as the blocks that can run are evaluated; a jnt whose comparison
+// has a known outcome only makes one of its edges executable.
+//
+// Afterwards every arithmetic op, copy or phi with a constant result becomes
+// a movi, a jnt that is never taken is removed and one that always is
+// becomes a jmp, and blocks that can't run lose their instructions. A jmp
+// that now only skips emptied blocks is removed with their labels. The ops
+// left without users (the operands of folded ops, the compare of a removed
+// branch, the target of a removed jmp) are for dead code elimination to
+// take out.
+//
+// Arithmetic wraps around like the machine's 32-bit registers; a division
+// by zero (or INT_MIN / -1) is left for run time.
+
+// returns true if the program changed; cfg is the program's CFG
+bool PropagateConstants(CodeContext& program, const CFG& cfg);
@@ -0,0 +1,825 @@
+#include "SSA.h"
+#include "CFG.h"
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <utility>
+
+// Construction follows Cytron et al.: phis go on the iterated dominance
+// frontier of the blocks that store to a slot, then a walk down the
+// dominator tree keeps a stack of the current value of every slot.
+
+namespace
+{
+	// first label of a block, once LabelBlocks has run
+	int BlockLabel(const CodeContext& program, const BasicBlock& block)
+	{
+		return program.opsVector[block.first].params[0].value;
+	}
+
+	// gives every block that doesn't start with a label one
+	void LabelBlocks(CodeContext& program, const CFG& cfg)
+	{
+		std::vector<Ops> result;
+		result.reserve(program.opsVector.size() + cfg.GetNumBlocks());
+		for (int b = 0; b < cfg.GetNumBlocks(); b++)
+		{
+			const BasicBlock& block = cfg.GetBlock(b);
+			if (program.opsVector[block.first].op != OpCode::Label)
+			{
+				result.emplace_back(Ops(OpCode::Label, program.NewLabel()));
+			}
+			result.insert(result.end(), program.opsVector.begin() + block.first,
+				program.opsVector.begin() + block.end);
+		}
+		program.opsVector.swap(result);
+	}
+
+	class SSABuilder
+	{
+	public:
+		SSABuilder(CodeContext& program, const CFG& cfg)
+			:mProgram(program)
+			,mCfg(cfg)
+		{ }
+
+		void Run();
+
+	private:
+		void PlacePhis();
+		void Rename();
+		void VisitBlock(int b);
+		void RemoveUselessPhis();
+		void Rewrite();
+
+		// value a slot holds at this point of the walk
+		Operand Current(int slot)
+		{
+			if (!mStacks[slot].empty())
+			{
+				return mStacks[slot].back();
+			}
+			// never stored on this path: what the data section pushed,
+			// loaded once at the end of the entry block
+			if (mInit[slot].kind == OperandKind::None)
+			{
+				mInit[slot] = mProgram.NewVReg();
+			}
+			return mInit[slot];
+		}
+
+		void Define(int slot, Operand value)
+		{
+			mStacks[slot].emplace_back(value);
+			mLog.emplace_back(slot);
+		}
+
+		// value an operand stands for after loads and trivial phis are gone
+		Operand Find(Operand operand) const
+		{
+			while (operand.IsVReg() && operand.value < static_cast<int>(mReplace.size())
+				&& mReplace[operand.value].kind != OperandKind::None)
+			{
+				operand = mReplace[operand.value];
+			}
+			return operand;
+		}
+
+		CodeContext& mProgram;
+		const CFG& mCfg;
+		int mNumSlots = 0;
+
+		// phis by block, and the register each one defines
+		std::vector<std::vector<int>> mBlockPhis;
+		std::vector<Operand> mPhiDst;
+		std::vector<bool> mPhiLive;
+
+		std::vector<std::vector<Operand>> mStacks;
+		// slots defined so far in the blocks being walked, to undo on the way up
+		std::vector<int> mLog;
+		std::vector<Operand> mInit;
+
+		// what each removed loadi's (or trivial phi's) register stands for
+		std::vector<Operand> mReplace;
+		std::vector<bool> mRemoved;
+		// registers inc/dec write to
+		std::vector<bool> mInPlace;
+
+		// slots with a store anywhere, and what they hold at each exit
+		struct ExitStore
+		{
+			int index;
+			int slot;
+			Operand value;
+		};
+		std::vector<int> mStoredSlots;
+		std::vector<ExitStore> mExitStores;
+	};
+
+	void SSABuilder::Run()
+	{
+		mNumSlots = static_cast<int>(mProgram.arraySlots.size());
+		mStacks.assign(mNumSlots, std::vector<Operand>());
+		mInit.assign(mNumSlots, Operand());
+		mBlockPhis.assign(mCfg.GetNumBlocks(), std::vector<int>());
+		mInPlace.assign(mProgram.lastVRegIndex, false);
+		for (const Ops& ops : mProgram.opsVector)
+		{
+			if ((ops.op == OpCode::Inc || ops.op == OpCode::Dec) && ops.params[0].IsVReg())
+			{
+				mInPlace[ops.params[0].value] = true;
+			}
+		}
+
+		PlacePhis();
+		Rename();
+		RemoveUselessPhis();
+		Rewrite();
+	}
+
+	void SSABuilder::PlacePhis()
+	{
+		int numBlocks = mCfg.GetNumBlocks();
+
+		// dominance frontiers: a join is in the frontier of every block on
+		// the way up from each predecessor to the join's idom
+		std::vector<std::vector<int>> frontier(numBlocks);
+		for (int b = 0; b < numBlocks; b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			if (block.preds.size() < 2 || !mCfg.IsReachable(b))
+			{
+				continue;
+			}
+			for (int pred : block.preds)
+			{
+				for (int runner = pred; runner >= 0 && runner != block.idom && mCfg.IsReachable(runner);
+					runner = mCfg.GetBlock(runner).idom)
+				{
+					if (frontier[runner].empty() || frontier[runner].back() != b)
+					{
+						frontier[runner].emplace_back(b);
+					}
+				}
+			}
+		}
+
+		// blocks storing to each slot
+		std::vector<std::vector<int>> defBlocks(mNumSlots);
+		for (int b = 0; b < numBlocks; b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			for (int i = block.first; i < block.end; i++)
+			{
+				const Ops& ops = mProgram.opsVector[i];
+				if (ops.op == OpCode::Storei && mProgram.IsScalarSlot(ops.params[0]))
+				{
+					std::vector<int>& blocks = defBlocks[ops.params[0].value];
+					if (blocks.empty() || blocks.back() != b)
+					{
+						blocks.emplace_back(b);
+					}
+				}
+			}
+		}
+
+		for (int slot = 0; slot < mNumSlots; slot++)
+		{
+			if (!defBlocks[slot].empty())
+			{
+				mStoredSlots.emplace_back(slot);
+			}
+		}
+
+		// iterated frontier of each slot's stores; marks hold slot + 1
+		std::vector<int> hasPhi(numBlocks, 0);
+		std::vector<int> queued(numBlocks, 0);
+		std::vector<int> work;
+		for (int slot = 0; slot < mNumSlots; slot++)
+		{
+			work = defBlocks[slot];
+			for (int b : work)
+			{
+				queued[b] = slot + 1;
+			}
+			while (!work.empty())
+			{
+				int b = work.back();
+				work.pop_back();
+				for (int join : frontier[b])
+				{
+					if (hasPhi[join] != slot + 1)
+					{
+						hasPhi[join] = slot + 1;
+						mBlockPhis[join].emplace_back(static_cast<int>(mProgram.phis.size()));
+						mProgram.phis.emplace_back(Phi{ slot, std::vector<PhiArg>() });
+						mPhiDst.emplace_back(mProgram.NewVReg());
+					}
+					if (queued[join] != slot + 1)
+					{
+						queued[join] = slot + 1;
+						work.emplace_back(join);
+					}
+				}
+			}
+		}
+		mPhiLive.assign(mProgram.phis.size(), true);
+	}
+
+	// dominator tree walk with an explicit stack: a block is visited on the
+	// way down and its definitions are popped again on the way up
+	void SSABuilder::Rename()
+	{
+		if (mCfg.GetNumBlocks() == 0)
+		{
+			return;
+		}
+
+		mReplace.assign(mProgram.lastVRegIndex, Operand());
+		mRemoved.assign(mProgram.opsVector.size(), false);
+
+		struct Frame
+		{
+			int block;
+			// log size before the block, or -1 before it is visited
+			int logSize;
+		};
+		std::vector<Frame> frames;
+		frames.emplace_back(Frame{ 0, -1 });
+		while (!frames.empty())
+		{
+			Frame frame = frames.back();
+			frames.pop_back();
+			if (frame.logSize >= 0)
+			{
+				while (static_cast<int>(mLog.size()) > frame.logSize)
+				{
+					mStacks[mLog.back()].pop_back();
+					mLog.pop_back();
+				}
+				continue;
+			}
+
+			frames.emplace_back(Frame{ frame.block, static_cast<int>(mLog.size()) });
+			VisitBlock(frame.block);
+			for (int child : mCfg.GetDomChildren(frame.block))
+			{
+				frames.emplace_back(Frame{ child, -1 });
+			}
+		}
+	}
+
+	void SSABuilder::VisitBlock(int b)
+	{
+		const BasicBlock& block = mCfg.GetBlock(b);
+		for (int phi : mBlockPhis[b])
+		{
+			Define(mProgram.phis[phi].slot, mPhiDst[phi]);
+		}
+
+		for (int i = block.first; i < block.end; i++)
+		{
+			Ops& ops = mProgram.opsVector[i];
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				if (ops.params[j].IsVReg() && IsUse(ops, j))
+				{
+					ops.params[j] = Find(ops.params[j]);
+				}
+			}
+
+			if (ops.op == OpCode::Loadi && mProgram.IsScalarSlot(ops.params[1]))
+			{
+				// a register inc/dec changes in place can't stand for the
+				// value, it gets a copy of it
+				Operand value = Current(ops.params[1].value);
+				if (mInPlace[ops.params[0].value])
+				{
+					ops = Ops(OpCode::Mov, ops.params[0], value);
+				}
+				else
+				{
+					mReplace[ops.params[0].value] = value;
+					mRemoved[i] = true;
+				}
+			}
+			else if (ops.op == OpCode::Storei && mProgram.IsScalarSlot(ops.params[0]))
+			{
+				Define(ops.params[0].value, ops.params[1]);
+			}
+			else if (ops.op == OpCode::Exit)
+			{
+				// slots never stored on the way here still hold their
+				// initial value
+				for (int slot : mStoredSlots)
+				{
+					if (!mStacks[slot].empty())
+					{
+						mExitStores.emplace_back(ExitStore{ i, slot, mStacks[slot].back() });
+					}
+				}
+			}
+		}
+
+		int label = BlockLabel(mProgram, block);
+		for (int succ : block.succs)
+		{
+			for (int phi : mBlockPhis[succ])
+			{
+				mProgram.phis[phi].args.emplace_back(PhiArg{ label, Current(mProgram.phis[phi].slot) });
+			}
+		}
+	}
+
+	// Phis whose arguments are all the same value (or the phi itself) stand
+	// for that value; phis nothing reads are dropped.
+	void SSABuilder::RemoveUselessPhis()
+	{
+		int numPhis = static_cast<int>(mProgram.phis.size());
+		mReplace.resize(mProgram.lastVRegIndex, Operand());
+
+		std::vector<int> phiOf(mProgram.lastVRegIndex, -1);
+		for (int phi = 0; phi < numPhis; phi++)
+		{
+			phiOf[mPhiDst[phi].value] = phi;
+		}
+
+		// A phi only has to be looked at again when one that it reads turns
+		// out to be trivial. The phis reading phi p are those at
+		// readers[readerStart[p]] up to readerStart[p + 1]; a trivial phi's
+		// readers then read the phi it stood for, which is linked in front
+		// of its own through merged.
+		std::vector<int> readerStart(numPhis + 1, 0);
+		auto readPhi = [&](int phi, const PhiArg& arg) {
+			Operand value = Find(arg.value);
+			return value.IsVReg() && phiOf[value.value] != phi ? phiOf[value.value] : -1;
+		};
+		for (int phi = 0; phi < numPhis; phi++)
+		{
+			for (const PhiArg& arg : mProgram.phis[phi].args)
+			{
+				int read = readPhi(phi, arg);
+				if (read >= 0)
+				{
+					readerStart[read + 1]++;
+				}
+			}
+		}
+		for (int phi = 0; phi < numPhis; phi++)
+		{
+			readerStart[phi + 1] += readerStart[phi];
+		}
+		std::vector<int> readers(readerStart[numPhis]);
+		std::vector<int> next(readerStart.begin(), readerStart.end() - 1);
+		for (int phi = 0; phi < numPhis; phi++)
+		{
+			for (const PhiArg& arg : mProgram.phis[phi].args)
+			{
+				int read = readPhi(phi, arg);
+				if (read >= 0)
+				{
+					readers[next[read]++] = phi;
+				}
+			}
+		}
+		std::vector<int> merged(numPhis, -1);
+		std::vector<int> lastMerged(numPhis);
+		for (int phi = 0; phi < numPhis; phi++)
+		{
+			lastMerged[phi] = phi;
+		}
+
+		std::vector<int> work;
+		std::vector<bool> queued(numPhis, true);
+		for (int phi = numPhis - 1; phi >= 0; phi--)
+		{
+			work.emplace_back(phi);
+		}
+		while (!work.empty())
+		{
+			int phi = work.back();
+			work.pop_back();
+			queued[phi] = false;
+			if (!mPhiLive[phi])
+			{
+				continue;
+			}
+			int dst = mPhiDst[phi].value;
+			Operand unique;
+			bool trivial = true;
+			for (const PhiArg& arg : mProgram.phis[phi].args)
+			{
+				Operand value = Find(arg.value);
+				if (value.value == dst)
+				{
+					continue;
+				}
+				if (unique.kind == OperandKind::None)
+				{
+					unique = value;
+				}
+				else if (unique.value != value.value)
+				{
+					trivial = false;
+					break;
+				}
+			}
+			if (!trivial || unique.kind == OperandKind::None)
+			{
+				continue;
+			}
+
+			mReplace[dst] = unique;
+			mPhiLive[phi] = false;
+			for (int from = phi; from >= 0; from = merged[from])
+			{
+				for (int r = readerStart[from]; r < readerStart[from + 1]; r++)
+				{
+					int reader = readers[r];
+					if (mPhiLive[reader] && !queued[reader])
+					{
+						queued[reader] = true;
+						work.emplace_back(reader);
+					}
+				}
+			}
+			int into = unique.IsVReg() ? phiOf[unique.value] : -1;
+			if (into >= 0)
+			{
+				merged[lastMerged[into]] = phi;
+				lastMerged[into] = lastMerged[phi];
+			}
+		}
+
+		// reads of each phi's register by instructions and live phis
+		std::vector<int> uses(numPhis, 0);
+		for (int phi = 0; phi < numPhis; phi++)
+		{
+			if (!mPhiLive[phi])
+			{
+				phiOf[mPhiDst[phi].value] = -1;
+			}
+		}
+		auto countUse = [&](Operand value, int delta) {
+			value = Find(value);
+			if (value.IsVReg() && phiOf[value.value] >= 0)
+			{
+				uses[phiOf[value.value]] += delta;
+			}
+		};
+		for (size_t i = 0; i < mProgram.opsVector.size(); i++)
+		{
+			const Ops& ops = mProgram.opsVector[i];
+			if (mRemoved[i])
+			{
+				continue;
+			}
+			for (int j = 0; j < ops.numParams; j++)
+			{
+				if (IsUse(ops, j))
+				{
+					countUse(ops.params[j], 1);
+				}
+			}
+		}
+		for (const ExitStore& store : mExitStores)
+		{
+			countUse(store.value, 1);
+		}
+		for (int phi = 0; phi < numPhis; phi++)
+		{
+			if (mPhiLive[phi])
+			{
+				for (const PhiArg& arg : mProgram.phis[phi].args)
+				{
+					countUse(arg.value, 1);
+				}
+			}
+		}
+
+		for (int phi = 0; phi < numPhis; phi++)
+		{
+			if (mPhiLive[phi] && uses[phi] == 0)
+			{
+				work.emplace_back(phi);
+			}
+		}
+		while (!work.empty())
+		{
+			int phi = work.back();
+			work.pop_back();
+			mPhiLive[phi] = false;
+			for (const PhiArg& arg : mProgram.phis[phi].args)
+			{
+				Operand value = Find(arg.value);
+				if (value.IsVReg() && phiOf[value.value] >= 0 && value.value != mPhiDst[phi].value)
+				{
+					int other = phiOf[value.value];
+					if (mPhiLive[other] && --uses[other] == 0)
+					{
+						work.emplace_back(other);
+					}
+				}
+			}
+		}
+	}
+
+	// lays the program out again: live phis after each block's labels, the
+	// initial loads after the data section, removed loads left out and the
+	// final stores before each exit
+	void SSABuilder::Rewrite()
+	{
+		std::vector<Phi> phis;
+		std::vector<Ops> result;
+		result.reserve(mProgram.opsVector.size() + mProgram.phis.size() + mNumSlots + mExitStores.size());
+
+		// exits were visited in dominator tree order
+		std::stable_sort(mExitStores.begin(), mExitStores.end(),
+			[](const ExitStore& a, const ExitStore& b) { return a.index < b.index; });
+		size_t nextStore = 0;
+
+		for (int b = 0; b < mCfg.GetNumBlocks(); b++)
+		{
+			const BasicBlock& block = mCfg.GetBlock(b);
+			int i = block.first;
+			while (i < block.end && mProgram.opsVector[i].op == OpCode::Label)
+			{
+				result.emplace_back(mProgram.opsVector[i++]);
+			}
+
+			for (int phi : mBlockPhis[b])
+			{
+				if (!mPhiLive[phi])
+				{
+					continue;
+				}
+				Phi live = mProgram.phis[phi];
+				for (PhiArg& arg : live.args)
+				{
+					arg.value = Find(arg.value);
+				}
+				result.emplace_back(Ops(OpCode::Phi, mPhiDst[phi], Operand::Imm(static_cast<int>(phis.size()))));
+				phis.emplace_back(live);
+			}
+
+			if (b == 0)
+			{
+				int numPushes = 0;
+				while (i < block.end && numPushes < mProgram.lastStackIndex
+					&& mProgram.opsVector[i].op == OpCode::Push)
+				{
+					result.emplace_back(mProgram.opsVector[i++]);
+					numPushes++;
+				}
+				for (int slot = 0; slot < mNumSlots; slot++)
+				{
+					if (mInit[slot].kind != OperandKind::None)
+					{
+						result.emplace_back(Ops(OpCode::Loadi, mInit[slot], Operand::Stack(slot)));
+					}
+				}
+			}
+
+			for (; i < block.end; i++)
+			{
+				if (mRemoved[i])
+				{
+					continue;
+				}
+				for (; nextStore < mExitStores.size() && mExitStores[nextStore].index == i; nextStore++)
+				{
+					const ExitStore& store = mExitStores[nextStore];
+					result.emplace_back(Ops(OpCode::Storei, Operand::Stack(store.slot), Find(store.value)));
+				}
+				Ops ops = mProgram.opsVector[i];
+				for (int j = 0; j < ops.numParams; j++)
+				{
+					if (IsUse(ops, j))
+					{
+						ops.params[j] = Find(ops.params[j]);
+					}
+				}
+				result.emplace_back(ops);
+			}
+		}
+
+		mProgram.opsVector.swap(result);
+		mProgram.phis.swap(phis);
+	}
+
+	struct Copy
+	{
+		Operand dst;
+		Operand src;
+	};
+
+	Ops CopyOps(Operand dst, Operand src)
+	{
+		return src.kind == OperandKind::Imm ? Ops(OpCode::Movi, dst, src) : Ops(OpCode::Mov, dst, src);
+	}
+
+	// The copies of one edge happen at once. If one of them overwrites a
+	// register another one still reads, all of them go through new registers.
+	// Each copy writes a different phi's register, so only a copy's own
+	// register can be both read and written by it.
+	void EmitCopies(CodeContext& program, const std::vector<Copy>& copies, std::vector<Ops>& out)
+	{
+		std::vector<int> written;
+		written.reserve(copies.size());
+		for (const Copy& copy : copies)
+		{
+			written.emplace_back(copy.dst.value);
+		}
+		std::sort(written.begin(), written.end());
+		bool overlap = false;
+		for (const Copy& read : copies)
+		{
+			if (read.src.IsVReg() && read.src.value != read.dst.value
+				&& std::binary_search(written.begin(), written.end(), read.src.value))
+			{
+				overlap = true;
+			}
+		}
+
+		if (!overlap)
+		{
+			for (const Copy& copy : copies)
+			{
+				if (copy.src.kind != copy.dst.kind || copy.src.value != copy.dst.value)
+				{
+					out.emplace_back(CopyOps(copy.dst, copy.src));
+				}
+			}
+			return;
+		}
+
+		std::vector<Operand> temps;
+		for (const Copy& copy : copies)
+		{
+			temps.emplace_back(program.NewVReg());
+			out.emplace_back(CopyOps(temps.back(), copy.src));
+		}
+		for (size_t i = 0; i < copies.size(); i++)
+		{
+			out.emplace_back(Ops(OpCode::Mov, copies[i].dst, temps[i]));
+		}
+	}
+
+	// a block of copies on an edge from a block with two successors
+	struct EdgeSplit
+	{
+		int pred;
+		int block;
+		Operand label;
+		std::vector<Copy> copies;
+	};
+}
+
+void BuildSSA(CodeContext& program, const CFG& before)
+{
+	LabelBlocks(program, before);
+	CFG cfg(program);
+	SSABuilder builder(program, cfg);
+	builder.Run();
+}
+
+void DestroySSA(CodeContext& program, const CFG& cfg)
+{
+	if (program.phis.empty())
+	{
+		return;
+	}
+
+	int numBlocks = cfg.GetNumBlocks();
+
+	// copies at the end of each predecessor, or on a block of their own if
+	// the predecessor also goes somewhere else
+	std::vector<std::vector<Copy>> copies(numBlocks);
+	std::vector<EdgeSplit> splits;
+	std::map<std::pair<int, int>, int> splitOf;
+	for (int b = 0; b < numBlocks; b++)
+	{
+		const BasicBlock& block = cfg.GetBlock(b);
+		for (int i = block.first; i < block.end; i++)
+		{
+			const Ops& ops = program.opsVector[i];
+			if (ops.op != OpCode::Phi)
+			{
+				continue;
+			}
+			for (const PhiArg& arg : program.phis[ops.params[1].value].args)
+			{
+				int pred = cfg.GetLabelBlock(arg.pred);
+				if (pred < 0 || !cfg.IsReachable(pred))
+				{
+					continue;
+				}
+				Copy copy{ ops.params[0], arg.value };
+				if (cfg.GetBlock(pred).succs.size() < 2)
+				{
+					copies[pred].emplace_back(copy);
+					continue;
+				}
+				auto found = splitOf.find(std::make_pair(pred, b));
+				if (found == splitOf.end())
+				{
+					found = splitOf.emplace(std::make_pair(pred, b), static_cast<int>(splits.size())).first;
+					splits.emplace_back(EdgeSplit{ pred, b, program.NewLabel(), std::vector<Copy>() });
+				}
+				splits[found->second].copies.emplace_back(copy);
+			}
+		}
+	}
+
+	std::vector<std::vector<int>> splitsFrom(numBlocks);
+	for (int s = 0; s < static_cast<int>(splits.size()); s++)
+	{
+		splitsFrom[splits[s].pred].emplace_back(s);
+	}
+
+	std::vector<Ops> result;
+	result.reserve(program.opsVector.size() + 4 * splits.size());
+	for (int b = 0; b < numBlocks; b++)
+	{
+		const BasicBlock& block = cfg.GetBlock(b);
+		int last = block.end - 1;
+		bool jumps = program.opsVector[last].op == OpCode::Jmp || program.opsVector[last].op == OpCode::Jnt;
+
+		// a jump along a split edge goes to the split's block instead: the
+		// movi of its target is changed if it is in this block, otherwise
+		// (moved out of a loop, say) the jump gets a movi of its own
+		int jumpSplit = -1;
+		for (int s : splitsFrom[b])
+		{
+			if (splits[s].block != b + 1)
+			{
+				jumpSplit = s;
+			}
+		}
+		int targetDef = -1;
+		for (int i = block.first; i < last && jumpSplit >= 0; i++)
+		{
+			const Ops& ops = program.opsVector[i];
+			if (ops.op == OpCode::Movi && ops.params[0].IsVReg()
+				&& ops.params[0].value == program.opsVector[last].params[0].value)
+			{
+				targetDef = i;
+			}
+		}
+
+		for (int i = block.first; i < block.end; i++)
+		{
+			Ops ops = program.opsVector[i];
+			if (ops.op == OpCode::Phi)
+			{
+				continue;
+			}
+			if (jumps && i == last)
+			{
+				EmitCopies(program, copies[b], result);
+				if (jumpSplit >= 0 && targetDef < 0)
+				{
+					Operand target = program.NewVReg();
+					result.emplace_back(Ops(OpCode::Movi, target, splits[jumpSplit].label));
+					ops.params[0] = target;
+				}
+			}
+			if (i == targetDef)
+			{
+				ops.params[1] = splits[jumpSplit].label;
+			}
+			result.emplace_back(ops);
+		}
+		if (!jumps)
+		{
+			EmitCopies(program, copies[b], result);
+		}
+
+		// the fall-through edge's copies go between the block and the next
+		for (int s : splitsFrom[b])
+		{
+			if (splits[s].block == b + 1)
+			{
+				result.emplace_back(Ops(OpCode::Label, splits[s].label));
+				EmitCopies(program, splits[s].copies, result);
+			}
+		}
+	}
+
+	// split jump edges go after the end of the program and jump on
+	for (const EdgeSplit& split : splits)
+	{
+		if (split.block == split.pred + 1)
+		{
+			continue;
+		}
+		result.emplace_back(Ops(OpCode::Label, split.label));
+		EmitCopies(program, split.copies, result);
+		Operand target = program.NewVReg();
+		result.emplace_back(Ops(OpCode::Movi, target, Operand::Label(BlockLabel(program, cfg.GetBlock(split.block)))));
+		result.emplace_back(Ops(OpCode::Jmp, target));
+	}
+
+	program.opsVector.swap(result);
+	program.phis.clear();
+}
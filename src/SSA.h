@@ -0,0 +1,28 @@
+#pragma once
+#include "IR.h"
+
+class CFG;
+
+// SSA form
+// CodeGen keeps every scalar variable in its stack slot and reloads it for
+// each use. BuildSSA promotes those slots to values: every loadi of a scalar
+// slot is replaced by the value the slot holds at that point, and blocks
+// where different values meet get a Phi pseudo-op choosing by predecessor.
+// The storei's stay, so the stack keeps the same contents as before, and
+// before each exit the final value of every stored slot is stored once more:
+// that makes every other store dead if only the memory left at the end is
+// observed (see RemoveDeadStores).
+//
+// While the program is in SSA form every block starts with a label, so phis
+// (and passes) can refer to blocks by label id across CFG rebuilds. A loadi
+// whose register is changed in place by inc/dec becomes a mov from the value.
+// DestroySSA turns the phis back into movs at the end of the predecessors,
+// splitting edges from blocks with two successors; it has to run before
+// register allocation.
+
+// promotes the scalar stack slots of the program to SSA values;
+// cfg is the program's CFG before the call
+void BuildSSA(CodeContext& program, const CFG& cfg);
+
+// replaces every phi with copies on the edges into its block
+void DestroySSA(CodeContext& program, const CFG& cfg);
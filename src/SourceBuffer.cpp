@@ -0,0 +1,82 @@
+#include "SourceBuffer.h"
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <cstdio>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SourceBuffer::~SourceBuffer()
+{
+#ifndef _WIN32
+	if (mMapped)
+	{
+		munmap(mData, mMappedLength);
+	}
+#endif
+}
+
+bool SourceBuffer::Open(const std::string& path)
+{
+#ifndef _WIN32
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+	{
+		size_t size = static_cast<size_t>(info.st_size);
+		size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		size_t tail = size % page;
+
+		// needs two bytes of zero fill after the end of the file in the last page
+		if (tail != 0 && page - tail >= 2)
+		{
+			void* addr = mmap(nullptr, size + 2, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			if (addr != MAP_FAILED)
+			{
+				close(fd);
+				mData = static_cast<char*>(addr);
+				mSize = size;
+				mMappedLength = size + 2;
+				mMapped = true;
+				return true;
+			}
+		}
+	}
+	close(fd);
+#endif
+	return ReadFile(path);
+}
+
+bool SourceBuffer::ReadFile(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	mCopy.clear();
+	char chunk[64 * 1024];
+	size_t count = 0;
+	while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0)
+	{
+		mCopy.insert(mCopy.end(), chunk, chunk + count);
+	}
+	fclose(file);
+
+	mSize = mCopy.size();
+	mCopy.push_back('\0');
+	mCopy.push_back('\0');
+	mData = mCopy.data();
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// SourceBuffer
+// the contents of a source file, laid out the way flex's yy_scan_buffer wants
+// them: the text followed by two null bytes. When the file doesn't end exactly
+// at a page boundary it is memory mapped, and the zero fill at the end of the
+// last page serves as the two null bytes, so the file is never copied. Otherwise
+// (or where mmap isn't available) it is read into memory.
+// The mapping is private and writable because the scanner temporarily writes
+// a null after each token.
+class SourceBuffer
+{
+public:
+	SourceBuffer() = default;
+	SourceBuffer(const SourceBuffer&) = delete;
+	SourceBuffer& operator=(const SourceBuffer&) = delete;
+	~SourceBuffer();
+
+	// returns false if the file can't be opened
+	bool Open(const std::string& path);
+
+	// text plus the two null bytes
+	char* GetData() { return mData; }
+	size_t GetScanSize() const { return mSize + 2; }
+
+private:
+	bool ReadFile(const std::string& path);
+
+	char* mData = nullptr;
+	size_t mSize = 0;
+	size_t mMappedLength = 0;
+	bool mMapped = false;
+	// used when the file is read instead of mapped
+	std::vector<char> mCopy;
+};
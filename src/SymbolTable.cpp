@@ -0,0 +1,67 @@
+#include "SymbolTable.h"
+#include <cstring>
+
+namespace
+{
+	// FNV-1a
+	unsigned HashName(const char* text, int length)
+	{
+		unsigned hash = 2166136261u;
+		for (int i = 0; i < length; i++)
+		{
+			hash ^= static_cast<unsigned char>(text[i]);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+}
+
+SymbolTable::SymbolTable()
+	:mSlots(64, -1)
+{
+}
+
+int SymbolTable::Intern(const char* text, int length)
+{
+	unsigned hash = HashName(text, length);
+	size_t mask = mSlots.size() - 1;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask)
+	{
+		int id = mSlots[i];
+		if (id == -1)
+		{
+			id = static_cast<int>(mNames.size());
+			mNames.push_back(TokenText{ text, length });
+			mHashes.push_back(hash);
+			mSlots[i] = id;
+			// keep the load factor at or below 1/2
+			if (mNames.size() * 2 > mSlots.size())
+			{
+				Grow();
+			}
+			return id;
+		}
+
+		const TokenText& name = mNames[id];
+		if (mHashes[id] == hash && name.length == length &&
+			std::memcmp(name.text, text, length) == 0)
+		{
+			return id;
+		}
+	}
+}
+
+void SymbolTable::Grow()
+{
+	mSlots.assign(mSlots.size() * 2, -1);
+	size_t mask = mSlots.size() - 1;
+	for (int id = 0; id < GetNumSymbols(); id++)
+	{
+		size_t i = mHashes[id] & mask;
+		while (mSlots[i] != -1)
+		{
+			i = (i + 1) & mask;
+		}
+		mSlots[i] = id;
+	}
+}
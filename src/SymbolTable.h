@@ -0,0 +1,47 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+// TokenText
+// an identifier or number as it appears in the source. Points straight into
+// the compilation's SourceBuffer, which outlives the AST; it is not null terminated.
+struct TokenText
+{
+	const char* text;
+	int length;
+
+	std::string ToString() const { return std::string(text, length); }
+};
+
+inline std::ostream& operator<<(std::ostream& stream, const TokenText& token)
+{
+	return stream.write(token.text, token.length);
+}
+
+// SymbolTable
+// interns identifiers as the scanner sees them: every distinct name gets a
+// dense id (0, 1, 2, ... in order of first appearance), so later stages can
+// keep per-name data in plain vectors indexed by id.
+// Open addressing with linear probing; the names themselves aren't copied.
+class SymbolTable
+{
+public:
+	SymbolTable();
+
+	// id of text[0, length), adding it if this is the first time it's seen
+	int Intern(const char* text, int length);
+
+	TokenText GetName(int id) const { return mNames[id]; }
+	int GetNumSymbols() const { return static_cast<int>(mNames.size()); }
+
+private:
+	void Grow();
+
+	// id -> name
+	std::vector<TokenText> mNames;
+	// hash of each name, so growing doesn't have to rehash the text
+	std::vector<unsigned> mHashes;
+	// hash slot -> id, -1 if empty; size is a power of 2
+	std::vector<int> mSlots;
+};
@@ -0,0 +1,264 @@
+#include "TextWriter.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// "00".."99", two characters per value
+	const char kDigitPairs[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+
+	int CountDigits(unsigned value)
+	{
+		int digits = 1;
+		while (value >= 10)
+		{
+			value /= 10;
+			digits++;
+		}
+		return digits;
+	}
+}
+
+TextWriter::TextWriter(std::ostream& stream)
+	:mBuffer(mStorage)
+	,mCapacity(kBufferSize)
+	,mStream(&stream)
+{
+}
+
+TextWriter::TextWriter(const std::string& path, bool mapped)
+{
+	if (mapped && OpenMapped(path))
+	{
+		return;
+	}
+
+	mFile.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (mFile.is_open())
+	{
+		mStream = &mFile;
+		mBuffer = mStorage;
+		mCapacity = kBufferSize;
+	}
+}
+
+TextWriter::~TextWriter()
+{
+	if (mFd >= 0)
+	{
+		CloseMapped();
+	}
+	else
+	{
+		Flush();
+	}
+}
+
+char* TextWriter::FormatInt(char* p, int value)
+{
+	// unsigned so INT_MIN negates safely
+	unsigned magnitude = static_cast<unsigned>(value);
+	if (value < 0)
+	{
+		*p++ = '-';
+		magnitude = 0u - magnitude;
+	}
+
+	// digits are filled in from the end, two at a time
+	char* end = p + CountDigits(magnitude);
+	char* q = end;
+	while (magnitude >= 100)
+	{
+		unsigned pair = (magnitude % 100) * 2;
+		magnitude /= 100;
+		*--q = kDigitPairs[pair + 1];
+		*--q = kDigitPairs[pair];
+	}
+	if (magnitude >= 10)
+	{
+		*--q = kDigitPairs[magnitude * 2 + 1];
+		*--q = kDigitPairs[magnitude * 2];
+	}
+	else
+	{
+		*--q = static_cast<char>('0' + magnitude);
+	}
+	return end;
+}
+
+void TextWriter::Flush()
+{
+	if (mStream != nullptr && mUsed > 0)
+	{
+		mStream->write(mBuffer, static_cast<std::streamsize>(mUsed));
+		mUsed = 0;
+	}
+}
+
+void TextWriter::WriteSlow(const char* text, size_t length)
+{
+	if (mBuffer == nullptr)
+	{
+		return;
+	}
+
+	// a big block to a stream goes out in one write
+	if (mStream != nullptr && length >= kBufferSize)
+	{
+		Flush();
+		mStream->write(text, static_cast<std::streamsize>(length));
+		return;
+	}
+
+	while (length > 0)
+	{
+		if (mUsed == mCapacity)
+		{
+			NextBuffer();
+		}
+		size_t chunk = mCapacity - mUsed < length ? mCapacity - mUsed : length;
+		std::memcpy(mBuffer + mUsed, text, chunk);
+		mUsed += chunk;
+		text += chunk;
+		length -= chunk;
+	}
+}
+
+void TextWriter::NextBuffer()
+{
+	if (mFd >= 0)
+	{
+		size_t fileEnd = mWindowOffset + mUsed;
+		if (!MapWindow(fileEnd))
+		{
+			// the file can't grow through a mapping (disk full, say), a
+			// stream gets the rest and fails or not on its own
+			SwitchToStream(fileEnd);
+		}
+	}
+	else
+	{
+		Flush();
+		// with no stream to take it (the file couldn't be reopened) the
+		// output is dropped
+		mUsed = 0;
+	}
+}
+
+#ifndef _WIN32
+
+bool TextWriter::OpenMapped(const std::string& path)
+{
+	mFd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (mFd < 0)
+	{
+		return false;
+	}
+	if (!MapWindow(0))
+	{
+		// the constructor opens a stream instead
+		close(mFd);
+		mFd = -1;
+		return false;
+	}
+	mPath = path;
+	return true;
+}
+
+bool TextWriter::MapWindow(size_t fileEnd)
+{
+	if (mBuffer != nullptr)
+	{
+		munmap(mBuffer, mCapacity);
+		mBuffer = nullptr;
+	}
+
+	// mappings start on a page boundary, so the new window may begin with
+	// the tail of the last one
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t offset = fileEnd / page * page;
+	void* addr = MAP_FAILED;
+	if (ftruncate(mFd, static_cast<off_t>(offset + kMapWindow)) == 0)
+	{
+		addr = mmap(nullptr, kMapWindow, PROT_READ | PROT_WRITE, MAP_SHARED, mFd,
+			static_cast<off_t>(offset));
+	}
+	if (addr == MAP_FAILED)
+	{
+		return false;
+	}
+
+	mBuffer = static_cast<char*>(addr);
+	mCapacity = kMapWindow;
+	mUsed = fileEnd - offset;
+	mWindowOffset = offset;
+	return true;
+}
+
+void TextWriter::CloseMapped()
+{
+	size_t fileEnd = mWindowOffset + mUsed;
+	munmap(mBuffer, mCapacity);
+	mBuffer = nullptr;
+	// drop the unused rest of the last window
+	if (ftruncate(mFd, static_cast<off_t>(fileEnd)) != 0)
+	{
+		// nothing more to do, the file keeps its padding
+	}
+	close(mFd);
+	mFd = -1;
+}
+
+void TextWriter::SwitchToStream(size_t fileEnd)
+{
+	// everything up to fileEnd is in the file already (MapWindow unmapped
+	// the last window), the padding after it goes
+	if (ftruncate(mFd, static_cast<off_t>(fileEnd)) != 0)
+	{
+		// the stream overwrites what it can of it
+	}
+	close(mFd);
+	mFd = -1;
+
+	mFile.open(mPath, std::ios::in | std::ios::out | std::ios::binary);
+	mFile.seekp(static_cast<std::streamoff>(fileEnd));
+	mStream = mFile.is_open() ? &mFile : nullptr;
+	mBuffer = mStorage;
+	mCapacity = kBufferSize;
+	mUsed = 0;
+}
+
+#else
+
+bool TextWriter::OpenMapped(const std::string& path)
+{
+	return false;
+}
+
+bool TextWriter::MapWindow(size_t fileEnd)
+{
+	return false;
+}
+
+void TextWriter::CloseMapped()
+{
+}
+
+void TextWriter::SwitchToStream(size_t fileEnd)
+{
+}
+
+#endif
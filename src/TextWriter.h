@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include "SymbolTable.h"
+
+// TextWriter
+// collects output in a buffer and hands it on only when the buffer fills up
+// or the writer is flushed/destroyed, so writing a big file costs a few large
+// writes rather than one per line. Nothing is allocated on the way.
+// Output goes either to a stream, through a fixed buffer inside the writer,
+// or straight into a memory-mapped file, in which case the buffer is a window
+// of the mapping and nothing is copied at all (falls back to an ofstream where
+// mmap isn't available, or from the point where the file can't be mapped any
+// further).
+class TextWriter
+{
+public:
+	static const size_t kBufferSize = 64 * 1024;
+	// bytes mapped at a time when writing through a mapping
+	static const size_t kMapWindow = 8 * 1024 * 1024;
+	// longest number WriteInt/FormatInt produce ("-2147483648")
+	static const size_t kMaxIntLength = 11;
+
+	explicit TextWriter(std::ostream& stream);
+	// creates (or truncates) path; mapped = write through mmap
+	TextWriter(const std::string& path, bool mapped);
+	TextWriter(const TextWriter&) = delete;
+	TextWriter& operator=(const TextWriter&) = delete;
+	~TextWriter();
+
+	// false if the file couldn't be created
+	bool IsOpen() const { return mBuffer != nullptr; }
+
+	void Write(const char* text, size_t length)
+	{
+		if (length > mCapacity - mUsed)
+		{
+			WriteSlow(text, length);
+			return;
+		}
+		std::memcpy(mBuffer + mUsed, text, length);
+		mUsed += length;
+	}
+	void Write(const char* text) { Write(text, std::strlen(text)); }
+	void Write(TokenText text) { Write(text.text, static_cast<size_t>(text.length)); }
+	void Write(char c)
+	{
+		if (mUsed == mCapacity)
+		{
+			NextBuffer();
+		}
+		mBuffer[mUsed++] = c;
+	}
+
+	// decimal text of value
+	void WriteInt(int value)
+	{
+		Commit(FormatInt(Reserve(kMaxIntLength), value));
+	}
+
+	// Fast path for formatting in place: Reserve returns room for at least
+	// length (<= kBufferSize) contiguous bytes, Commit takes everything up to end.
+	char* Reserve(size_t length)
+	{
+		if (length > mCapacity - mUsed)
+		{
+			NextBuffer();
+		}
+		return mBuffer + mUsed;
+	}
+	void Commit(char* end) { mUsed = static_cast<size_t>(end - mBuffer); }
+
+	// writes the decimal text of value at p, returns the end of it
+	static char* FormatInt(char* p, int value);
+
+	// hands everything buffered so far to the stream; a mapped file doesn't
+	// need it, its bytes are already in place
+	void Flush();
+
+private:
+	void WriteSlow(const char* text, size_t length);
+
+	// makes room: flushes the stream buffer or moves the mapped window on
+	void NextBuffer();
+
+	bool OpenMapped(const std::string& path);
+	bool MapWindow(size_t fileEnd);
+	void CloseMapped();
+	// closes the mapping and appends the rest of the output through mFile
+	void SwitchToStream(size_t fileEnd);
+
+	char* mBuffer = nullptr;
+	size_t mCapacity = 0;
+	size_t mUsed = 0;
+
+	std::ostream* mStream = nullptr;
+	// used when the writer opens the file itself without a mapping
+	std::ofstream mFile;
+
+	// mapped file: mBuffer is the window starting at mWindowOffset
+	int mFd = -1;
+	size_t mWindowOffset = 0;
+	// reopened as a stream if a later window can't be mapped
+	std::string mPath;
+
+	char mStorage[kBufferSize];
+};
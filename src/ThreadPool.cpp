@@ -0,0 +1,115 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int numThreads)
+	:mPending(0)
+	,mQueued(0)
+{
+	if (numThreads < 1)
+	{
+		numThreads = 1;
+	}
+	for (int i = 0; i < numThreads; i++)
+	{
+		mQueues.emplace_back(new Queue());
+	}
+	for (int i = 0; i < numThreads; i++)
+	{
+		mThreads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for (auto& thread : mThreads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	Queue& queue = *mQueues[mNextQueue];
+	mNextQueue = (mNextQueue + 1) % static_cast<int>(mQueues.size());
+
+	mPending++;
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.emplace_back(std::move(task));
+	}
+	{
+		// taken so a worker can't miss the wakeup between checking mQueued and sleeping
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mQueued++;
+	}
+	mWake.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mSleepMutex);
+	mDone.wait(lock, [this] { return mPending == 0; });
+}
+
+void ThreadPool::WorkerLoop(int index)
+{
+	std::function<void()> task;
+	while (true)
+	{
+		if (PopLocal(index, task) || Steal(index, task))
+		{
+			mQueued--;
+			task();
+			task = nullptr;
+			if (--mPending == 0)
+			{
+				std::lock_guard<std::mutex> lock(mSleepMutex);
+				mDone.notify_all();
+			}
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mWake.wait(lock, [this] { return mStop || mQueued > 0; });
+		if (mStop && mQueued == 0)
+		{
+			return;
+		}
+	}
+}
+
+// own deque, newest task first
+bool ThreadPool::PopLocal(int index, std::function<void()>& task)
+{
+	Queue& queue = *mQueues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+	{
+		return false;
+	}
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	return true;
+}
+
+// other deques, oldest task first
+bool ThreadPool::Steal(int index, std::function<void()>& task)
+{
+	int count = static_cast<int>(mQueues.size());
+	for (int i = 1; i < count; i++)
+	{
+		Queue& queue = *mQueues[(index + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty())
+		{
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
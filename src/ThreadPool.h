@@ -0,0 +1,54 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ThreadPool
+// fixed set of workers with one task deque each. Submitted tasks are dealt
+// out round-robin; a worker runs its own deque newest-first and, once that is
+// empty, steals the oldest task from another worker's deque.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(int numThreads);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	void Submit(std::function<void()> task);
+
+	// blocks until every submitted task has finished
+	void Wait();
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void WorkerLoop(int index);
+	bool PopLocal(int index, std::function<void()>& task);
+	bool Steal(int index, std::function<void()>& task);
+
+	std::vector<std::unique_ptr<Queue>> mQueues;
+	std::vector<std::thread> mThreads;
+
+	// queue the next submitted task goes to
+	int mNextQueue = 0;
+
+	// tasks submitted but not yet finished, and tasks not yet started
+	std::atomic<int> mPending;
+	std::atomic<int> mQueued;
+
+	// idle workers sleep on mWake, Wait() sleeps on mDone
+	std::mutex mSleepMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	bool mStop = false;
+};
@@ -1,12 +1,98 @@
 #include "catch.hpp"
 #include "SrcMain.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 // Helper function declarations (don't change these)
 extern bool CheckFileMD5(const std::string& fileName, const std::string& expected);
 extern bool CheckTextFilesSame(const std::string& fileNameA, 
 	const std::string& fileNameB);
 
+// runs ProcessCommandArgs with whatever it prints to cout captured in output
+static int ProcessCommandArgsOutput(int argc, const char* argv[], std::string& output)
+{
+	std::ostringstream captured;
+	std::streambuf* old = std::cout.rdbuf(captured.rdbuf());
+	int result = ProcessCommandArgs(argc, argv);
+	std::cout.rdbuf(old);
+	output = captured.str();
+	return result;
+}
+
+// how many times text appears in output
+static size_t CountOccurrences(const std::string& output, const std::string& text)
+{
+	size_t count = 0;
+	for (size_t pos = output.find(text); pos != std::string::npos; pos = output.find(text, pos + text.size()))
+	{
+		count++;
+	}
+	return count;
+}
+
+// non-empty lines of a file; for emit.txt, one per instruction
+static std::vector<std::string> ReadLines(const std::string& fileName)
+{
+	std::ifstream file(fileName);
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (!line.empty())
+		{
+			lines.emplace_back(line);
+		}
+	}
+	return lines;
+}
+
+// how many lines start with an instruction's name
+static size_t CountInstructions(const std::vector<std::string>& lines, const std::string& name)
+{
+	size_t count = 0;
+	for (const std::string& line : lines)
+	{
+		if (line.compare(0, name.size() + 1, name + " ") == 0)
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+// The loop closed by the first backward jmp of an emitted program, as
+// instruction numbers; a jmp's target is loaded by the last movi before it
+static bool FindLoop(const std::vector<std::string>& lines, size_t& header, size_t& backEdge)
+{
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		if (lines[i].compare(0, 4, "jmp ") != 0)
+		{
+			continue;
+		}
+		std::string movi = "movi " + lines[i].substr(4) + ",";
+		for (size_t j = i; j-- > 0;)
+		{
+			if (lines[j].compare(0, movi.size(), movi) == 0)
+			{
+				size_t target = std::stoul(lines[j].substr(movi.size()));
+				if (target <= i)
+				{
+					header = target;
+					backEdge = i;
+					return true;
+				}
+				break;
+			}
+		}
+	}
+	return false;
+}
+
 //TEST_CASE("Student Grammar Tests", "[student]")
 //{
 //	SECTION("Test01")
@@ -352,4 +438,248 @@ TEST_CASE("Student Register Allocation Tests", "[student]")
 		bool resultEmit = CheckTextFilesSame("emit.txt", "expected/star.reg.emit.txt");
 		REQUIRE(resultEmit);
 	}
+	SECTION("Spill")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"input/spill.pcc",
+			"reg"
+		};
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+		bool resultReg = CheckTextFilesSame("reg.txt", "expected/spill.reg.txt");
+		REQUIRE(resultReg);
+		bool resultEmit = CheckTextFilesSame("emit.txt", "expected/spill.reg.emit.txt");
+		REQUIRE(resultEmit);
+	}
+}
+
+TEST_CASE("Student Batch Tests", "[student]")
+{
+	SECTION("Input Directory")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"--batch",
+			"emit reg",
+			"-j",
+			"4",
+			"-o",
+			"batch",
+			"input"
+		};
+		REQUIRE(ProcessCommandArgs(8, argv) == 0);
+		REQUIRE(CheckTextFilesSame("batch/test01.ast.txt", "expected/test01.ast.txt"));
+		REQUIRE(CheckTextFilesSame("batch/test01.emit.txt", "expected/test01.emit.txt"));
+		REQUIRE(CheckTextFilesSame("batch/star.emit.txt", "expected/star.emit.txt"));
+		REQUIRE(CheckTextFilesSame("batch/star.reg.txt", "expected/star.reg.txt"));
+		REQUIRE(CheckTextFilesSame("batch/star.reg.emit.txt", "expected/star.reg.emit.txt"));
+		REQUIRE(CheckTextFilesSame("batch/spill.reg.emit.txt", "expected/spill.reg.emit.txt"));
+	}
+	SECTION("Nested Output Directory")
+	{
+		// the parents of the output directory are created too
+		const char* argv[] = {
+			"tests/tests",
+			"--batch",
+			"emit",
+			"-o",
+			"batch/nested/out",
+			"input/test01.pcc"
+		};
+		REQUIRE(ProcessCommandArgs(6, argv) == 0);
+		REQUIRE(CheckTextFilesSame("batch/nested/out/test01.emit.txt", "expected/test01.emit.txt"));
+	}
+}
+
+TEST_CASE("Student Name Resolution Tests", "[student]")
+{
+	SECTION("Undeclared")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"input/errors/undeclared.pcc",
+			"emit"
+		};
+		std::string output;
+		REQUIRE(ProcessCommandArgsOutput(3, argv, output) == 1);
+		REQUIRE(output.find("ERROR: Undeclared identifier 'y'") != std::string::npos);
+	}
+	SECTION("Undeclared Reported Once")
+	{
+		// y is used twice, the error names it once
+		const char* argv[] = {
+			"tests/tests",
+			"input/errors/undeclared.pcc",
+			"emit"
+		};
+		std::string output;
+		REQUIRE(ProcessCommandArgsOutput(3, argv, output) == 1);
+		REQUIRE(CountOccurrences(output, "Undeclared identifier") == 1);
+	}
+	SECTION("Duplicate")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"input/errors/duplicate.pcc",
+			"emit"
+		};
+		std::string output;
+		REQUIRE(ProcessCommandArgsOutput(3, argv, output) == 1);
+		REQUIRE(output.find("ERROR: Duplicate declaration of 'x'") != std::string::npos);
+	}
+	SECTION("Subscript On Var")
+	{
+		// a[1] would store to b's slot behind the back of the passes,
+		// which keep b in a register
+		const char* argv[] = {
+			"tests/tests",
+			"input/errors/subscript.pcc",
+			"emit -O2"
+		};
+		std::string output;
+		REQUIRE(ProcessCommandArgsOutput(3, argv, output) == 1);
+		REQUIRE(output.find("ERROR: 'a' is not an array") != std::string::npos);
+	}
+	SECTION("Array Without Subscript")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"input/errors/nosubscript.pcc",
+			"emit"
+		};
+		std::string output;
+		REQUIRE(ProcessCommandArgsOutput(3, argv, output) == 1);
+		REQUIRE(output.find("ERROR: Array 'a' used without a subscript") != std::string::npos);
+	}
+	SECTION("Integer Too Large")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"input/errors/toolarge.pcc",
+			"emit"
+		};
+		std::string output;
+		REQUIRE(ProcessCommandArgsOutput(3, argv, output) == 1);
+		REQUIRE(output.find("ERROR: Integer 2147483648 is too large on line 8") != std::string::npos);
+		REQUIRE(output.find("ERROR: Integer 99999999999999999999999 is too large on line 9") != std::string::npos);
+		REQUIRE(CountOccurrences(output, "too large") == 2);
+	}
+}
+
+TEST_CASE("Student Optimization Tests", "[student]")
+{
+	SECTION("O0")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"input/star.pcc",
+			"reg -O0"
+		};
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+		REQUIRE(CheckTextFilesSame("reg.txt", "expected/star.reg.txt"));
+		REQUIRE(CheckTextFilesSame("emit.txt", "expected/star.reg.emit.txt"));
+	}
+	SECTION("O1")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"input/test05.pcc",
+			"reg -O1"
+		};
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+		REQUIRE(CheckTextFilesSame("reg.txt", "expected/test05.O1.reg.txt"));
+		REQUIRE(CheckTextFilesSame("emit.txt", "expected/test05.O1.reg.emit.txt"));
+		// both array addresses (0 + 2) fold to a movi, and the movis that
+		// fed the adds are gone
+		std::vector<std::string> unoptimized = ReadLines("expected/test05.reg.emit.txt");
+		std::vector<std::string> optimized = ReadLines("emit.txt");
+		REQUIRE(CountInstructions(unoptimized, "add") == 2);
+		REQUIRE(CountInstructions(optimized, "add") == 0);
+		REQUIRE(optimized.size() < unoptimized.size());
+	}
+	SECTION("O2")
+	{
+		const char* argv[] = {
+			"tests/tests",
+			"input/star.pcc",
+			"reg -O2"
+		};
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+		REQUIRE(CheckTextFilesSame("reg.txt", "expected/star.O2.reg.txt"));
+		REQUIRE(CheckTextFilesSame("emit.txt", "expected/star.O2.reg.emit.txt"));
+		REQUIRE(ReadLines("emit.txt").size() < ReadLines("expected/star.reg.emit.txt").size());
+	}
+	SECTION("Loop Invariants")
+	{
+		// the loop bound 3 is loaded on every iteration at -O1 and once,
+		// before the loop, at -O2
+		auto loadsBound = [](const std::string& line) {
+			return line.compare(0, 5, "movi ") == 0 && line.compare(line.size() - 2, 2, ",3") == 0;
+		};
+		const char* argv[] = {
+			"tests/tests",
+			"input/spill.pcc",
+			"reg -O1"
+		};
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+		std::vector<std::string> lines = ReadLines("emit.txt");
+		size_t header = 0;
+		size_t backEdge = 0;
+		REQUIRE(FindLoop(lines, header, backEdge));
+		REQUIRE(std::count_if(lines.begin() + header, lines.begin() + backEdge + 1, loadsBound) == 1);
+
+		argv[2] = "reg -O2";
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+		lines = ReadLines("emit.txt");
+		REQUIRE(FindLoop(lines, header, backEdge));
+		REQUIRE(std::count_if(lines.begin() + header, lines.begin() + backEdge + 1, loadsBound) == 0);
+		REQUIRE(std::count_if(lines.begin(), lines.begin() + header, loadsBound) == 1);
+	}
+	SECTION("Memory")
+	{
+		// i, sides and starSize stay in registers in the loop and are
+		// stored once after it
+		const char* argv[] = {
+			"tests/tests",
+			"input/star.pcc",
+			"reg -O2"
+		};
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+		std::vector<std::string> lines = ReadLines("emit.txt");
+		size_t header = 0;
+		size_t backEdge = 0;
+		REQUIRE(FindLoop(lines, header, backEdge));
+		std::vector<std::string> loop(lines.begin() + header, lines.begin() + backEdge + 1);
+		std::vector<std::string> after(lines.begin() + backEdge + 1, lines.end());
+		REQUIRE(CountInstructions(loop, "loadi") == 0);
+		REQUIRE(CountInstructions(loop, "storei") == 0);
+		REQUIRE(CountInstructions(after, "storei") == 3);
+	}
+	SECTION("Memory Mode")
+	{
+		// the stack matches -O0 after every instruction, so ++i is
+		// still stored in the loop
+		const char* argv[] = {
+			"tests/tests",
+			"input/star.pcc",
+			"reg -O2 memory"
+		};
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+		std::vector<std::string> lines = ReadLines("emit.txt");
+		size_t header = 0;
+		size_t backEdge = 0;
+		REQUIRE(FindLoop(lines, header, backEdge));
+		std::vector<std::string> loop(lines.begin() + header, lines.begin() + backEdge + 1);
+		REQUIRE(CountInstructions(loop, "storei") == 1);
+	}
+	SECTION("Nested Loops")
+	{
+		// 3000 loops deep, every pass has to cope with the nesting
+		const char* argv[] = {
+			"tests/tests",
+			"input/nested.pcc",
+			"reg -O2"
+		};
+		REQUIRE(ProcessCommandArgs(3, argv) == 0);
+	}
 }